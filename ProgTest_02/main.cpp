@@ -18,6 +18,15 @@
 #include <memory>
 #include <compare>
 #include <complex>
+#include <bit>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <barrier>
+#include <type_traits>
+#include <utility>
+#include <stdexcept>
 #endif /* __PROGTEST__ */
 
 using namespace std;
@@ -42,14 +51,134 @@ private:
 };
 string poly_var::varName = "x";
 
+// Coefficient storage keeping up to INLINE values inside the object, so low degrees never allocate;
+// past that the values spill to a vector on the heap
+class CCoefficients {
+public:
+    static constexpr size_t INLINE = 8;
+
+    CCoefficients() = default;
+    CCoefficients(size_t count, double value){
+        assign(count, value);
+    }
+    CCoefficients(vector<double>&& values): _size(values.size()){
+        if (_size > INLINE) {
+            _heap = std::move(values);
+        } else {
+            copy(values.begin(), values.end(), _inline);
+        }
+    }
+    CCoefficients(const CCoefficients& other): _size(other._size), _heap(other._heap){
+        copyInline(other);
+    }
+    CCoefficients(CCoefficients&& other) noexcept: _size(other._size), _heap(std::move(other._heap)){
+        copyInline(other);
+        other._size = 0;
+    }
+    CCoefficients& operator=(const CCoefficients& other){
+        if (this != &other) {
+            _size = other._size;
+            _heap = other._heap;
+            copyInline(other);
+        }
+        return *this;
+    }
+    CCoefficients& operator=(CCoefficients&& other) noexcept{
+        if (this != &other) {
+            _size = other._size;
+            _heap = std::move(other._heap);
+            copyInline(other);
+            other._size = 0;
+        }
+        return *this;
+    }
+
+    size_t size() const{
+        return _size;
+    }
+    bool empty() const{
+        return _size == 0;
+    }
+    double * data(){
+        return _size > INLINE ? _heap.data() : _inline;
+    }
+    const double * data() const{
+        return _size > INLINE ? _heap.data() : _inline;
+    }
+    double * begin(){
+        return data();
+    }
+    double * end(){
+        return data() + _size;
+    }
+    const double * begin() const{
+        return data();
+    }
+    const double * end() const{
+        return data() + _size;
+    }
+    double& operator[](size_t index){
+        return data()[index];
+    }
+    double operator[](size_t index) const{
+        return data()[index];
+    }
+
+    void resize(size_t count, double value = 0.0){
+        if (count <= INLINE) {
+            if (_size > INLINE) {
+                copy_n(_heap.begin(), count, _inline);
+                _heap = {};
+            } else if (count > _size) {
+                fill(_inline + _size, _inline + count, value);
+            }
+        } else {
+            if (_size <= INLINE) {
+                _heap.reserve(count);
+                _heap.assign(_inline, _inline + _size);
+            }
+            _heap.resize(count, value);
+        }
+        _size = count;
+    }
+    void assign(size_t count, double value){
+        if (count > INLINE) {
+            _heap.assign(count, value);
+        } else {
+            _heap = {};
+            fill_n(_inline, count, value);
+        }
+        _size = count;
+    }
+private:
+    // Values on the heap leave the inline buffer uninitialized, there is nothing to copy then
+    void copyInline(const CCoefficients& other){
+        if (_size <= INLINE) copy_n(other._inline, _size, _inline);
+    }
+
+    size_t _size = 0;
+    double _inline[INLINE];
+    vector<double> _heap;
+};
+
 class CPolynomial {
+public:
+    using Term = pair<size_t, double>;
 private:
-    vector<double> _coefficients;
+    // Dense coefficients, or with _sparse set, the terms sorted by exponent; a term may hold a zero
+    CCoefficients _coefficients;
+    vector<Term> _terms;
+    bool _sparse = false;
 public:
     // Constructors and Destructor
     CPolynomial(): _coefficients(1,0.0){}
     CPolynomial(const CPolynomial& other):
-            _coefficients(other._coefficients){}
+            _coefficients(other._coefficients), _terms(other._terms), _sparse(other._sparse){}
+    // The source is left as the zero polynomial
+    CPolynomial(CPolynomial&& other) noexcept:
+            _coefficients(std::move(other._coefficients)), _terms(std::move(other._terms)), _sparse(other._sparse){
+        other.makeZero();
+    }
     ~CPolynomial()= default;
 
     // Assignment operator
@@ -58,6 +187,18 @@ public:
             return *this;
         }
         _coefficients = other._coefficients;
+        _terms = other._terms;
+        _sparse = other._sparse;
+        return *this;
+    }
+    CPolynomial& operator=(CPolynomial&& other) noexcept{
+        if (this == &other) {
+            return *this;
+        }
+        _coefficients = std::move(other._coefficients);
+        _terms = std::move(other._terms);
+        _sparse = other._sparse;
+        other.makeZero();
         return *this;
     }
 
@@ -65,9 +206,7 @@ public:
     friend std::ostream& operator<<(std::ostream& os, const CPolynomial& p){
         bool first = true;
 
-        for (int i = p._coefficients.size() - 1; i >= 0; i--) {
-            double c = p._coefficients[i];
-            if (c == 0) continue;
+        auto print = [&os, &first](size_t i, double c){
 
             if (!first) {
                 if (c > 0) os << " + ";
@@ -84,6 +223,15 @@ public:
                 os << "^" << i;
             }
             first = false;
+        };
+        if (p._sparse) {
+            for (auto it = p._terms.rbegin(); it != p._terms.rend(); ++it) {
+                if (it->second != 0) print(it->first, it->second);
+            }
+        } else {
+            for (int i = p._coefficients.size() - 1; i >= 0; i--) {
+                if (p._coefficients[i] != 0) print(i, p._coefficients[i]);
+            }
         }
         if (first) os << "0";
         return os;
@@ -94,6 +242,10 @@ public:
         for (double & _coefficient : _coefficients) {
             _coefficient *= scalar;
         }
+        for (Term & term : _terms) {
+            term.second *= scalar;
+        }
+        if (_sparse && scalar == 0) toDense();
         return *this;
     }
     CPolynomial& operator*=(int scalar){
@@ -101,42 +253,35 @@ public:
         return *this;
     }
     CPolynomial& operator*=(const CPolynomial& other){
-        CPolynomial res;
-        res._coefficients.resize(_coefficients.size() + other._coefficients.size() - 1, 0.0);
-        for(size_t i = 0; i < _coefficients.size(); i++) {
-            for(size_t j = 0; j < other._coefficients.size(); j++) {
-                res[i + j] += _coefficients[i] * other._coefficients[j];
-            }
-        }
-        *this = res;
-        return *this;
-    }
-    CPolynomial operator*(double scalar)const{
-        CPolynomial result(*this);
-        result *= scalar;
-        return result;
-    }
-    CPolynomial operator*(int scalar)const{
-        CPolynomial result(*this);
-        result *= static_cast<double>(scalar);
-        return result;
-    }
-    CPolynomial operator*(const CPolynomial& other)const{
-        CPolynomial result(*this);
-        result *= other;
-        return result;
+        return *this = product(*this, other, 1.0);
     }
+    // The * operators are below the class
 
-    friend CPolynomial operator*(double scalar, const CPolynomial & other){
-        return other * scalar;
-    }
-    friend CPolynomial operator*(int scalar, const CPolynomial & other){
-        return other * static_cast<double>(scalar);
+    // scale * a * b in a single new polynomial
+    static CPolynomial product(const CPolynomial& a, const CPolynomial& b, double scale){
+        CPolynomial res(CCoefficients{});
+        if (!a._sparse && !b._sparse) {
+            size_t degree = a.degree() + b.degree();
+            res._coefficients.assign(degree + 1, 0.0);
+            multiplyInto(span(a._coefficients).first(a.degree() + 1), span(b._coefficients).first(b.degree() + 1),
+                         res._coefficients, EKernel::Adaptive, scale);
+        } else {
+            res._terms = multiplySparse(a.terms(), b.terms());
+            for (Term & term : res._terms) {
+                term.second *= scale;
+            }
+            res._sparse = true;
+        }
+        res.normalize();
+        return res;
     }
 
 
     // Comparison operators
     bool operator==(const CPolynomial& other) const{
+        if (_sparse || other._sparse) {
+            return terms() == other.terms();
+        }
         size_t size = max(_coefficients.size(), other._coefficients.size());
 
         for (size_t i = 0; i < size; ++i) {
@@ -163,12 +308,32 @@ public:
 
     // Subscript operator
     double& operator[](size_t index){
+        if (!_sparse && index >= _coefficients.size() && index >= SPARSE_MIN
+                && index + 1 > SPARSE_SPAN * (_coefficients.size() + 1)
+                && index + 1 > SPARSE_SPAN * (nonzeroCount() + 1)) {
+            toSparse();
+        }
+        if (_sparse) {
+            auto it = lower_bound(_terms.begin(), _terms.end(), Term(index, 0.0), byExponent);
+            if (it != _terms.end() && it->first == index) {
+                return it->second;
+            }
+            it = _terms.insert(it, Term(index, 0.0));
+            if (_terms.back().first + 1 >= max(SPARSE_MIN, DENSE_SPAN * _terms.size())) {
+                return it->second;
+            }
+            toDense();
+        }
         if(index >= _coefficients.size()){
             _coefficients.resize(index + 1, 0.0);
         }
         return _coefficients[index];
     }
     double operator[](size_t index) const{
+        if (_sparse) {
+            auto it = findTerm(index);
+            return it == _terms.end() ? 0.0 : it->second;
+        }
         if(index >= _coefficients.size()){
             return 0.0;
         }
@@ -177,6 +342,16 @@ public:
 
     // Function call operator
     double operator()(double x) const{
+        if (_sparse) {
+            double res = 0, power = 1;
+            size_t exponent = 0;
+            for (const auto & [e, c] : _terms) {
+                power *= pow(x, double(e - exponent));
+                exponent = e;
+                res += power * c;
+            }
+            return res;
+        }
         double res = 0;
         double power = 1;
         for(auto c : _coefficients){
@@ -186,8 +361,129 @@ public:
         return res;
     }
 
+    enum class EScheme { Auto, Horner, Estrin };
+
+    // Values at every point of xs written to out, the points are split into threadCount contiguous blocks.
+    // Horner runs across LANES points at once; Estrin, the default for high degrees, evaluates blocks
+    // of coefficients independently and chains only the blocks, so far fewer steps wait for each other.
+    void evaluate(span<const double> xs, span<double> out, size_t threadCount = 1, EScheme scheme = EScheme::Auto) const{
+        size_t count = min(xs.size(), out.size());
+        if (_sparse) {
+            for (size_t i = 0; i < count; i++) {
+                out[i] = (*this)(xs[i]);
+            }
+            return;
+        }
+        span<const double> coefficients = span(_coefficients).first(degree() + 1);
+        if (scheme == EScheme::Auto) {
+            scheme = coefficients.size() > ESTRIN_DEGREE ? EScheme::Estrin : EScheme::Horner;
+        }
+        vector<double> blocks;
+        if (scheme == EScheme::Estrin) {
+            blocks.assign((coefficients.size() + ESTRIN_BLOCK - 1) / ESTRIN_BLOCK * ESTRIN_BLOCK, 0.0);
+            copy(coefficients.begin(), coefficients.end(), blocks.begin());
+        }
+        auto lanes = [&](const double * x, double * res){
+            if (scheme == EScheme::Estrin) {
+                evaluateLanes(true, blocks.data(), blocks.size() / ESTRIN_BLOCK, x, res);
+            } else {
+                evaluateLanes(false, coefficients.data(), coefficients.size(), x, res);
+            }
+        };
+        auto run = [&](size_t from, size_t to){
+            for (; from + LANES <= to; from += LANES) {
+                lanes(xs.data() + from, out.data() + from);
+            }
+            if (from < to) {
+                double x[LANES] = {}, res[LANES];
+                copy(xs.begin() + from, xs.begin() + to, x);
+                lanes(x, res);
+                copy(res, res + (to - from), out.begin() + from);
+            }
+        };
+
+        size_t block = (count / max<size_t>(threadCount, 1) + LANES - 1) / LANES * LANES;
+        if (threadCount <= 1 || block == 0) {
+            run(0, count);
+            return;
+        }
+        vector<thread> threads;
+        for (size_t from = block; from < count; from += block) {
+            threads.emplace_back(run, from, min(from + block, count));
+        }
+        run(0, min(block, count));
+        for (thread & th : threads) {
+            th.join();
+        }
+    }
+
+    // Tree is only accurate for small degrees, see evaluateMultipoint; Direct is the default
+    enum class EMultipoint { Direct, Tree };
+
+    // Values at every point of xs written to out. Direct is evaluate; Tree reduces the polynomial modulo
+    // the product of (x - xs[i]) over each half of the points, then each quarter and so on, and evaluates
+    // the short remainders, O(n log^2 n) against O(n^2). Remainders in floating point are only as good as
+    // the conditioning of the node products, which decays fast with the node degree for points spread over
+    // an interval, so the tree stays accurate only while the polynomial degree is in the tens; no size makes
+    // it the safe choice, so it runs only when asked for.
+    void evaluateMultipoint(span<const double> xs, span<double> out, EMultipoint method = EMultipoint::Direct) const{
+        size_t count = min(xs.size(), out.size());
+        if (method == EMultipoint::Direct || count == 0) {
+            evaluate(xs.first(count), out.first(count));
+            return;
+        }
+        CSubproductTree tree(xs.first(count));
+        evaluateTree(tree, denseCoefficients(), 0, 0, count, out);
+    }
+
+    // The polynomial of degree below n through the n points (xs[i], ys[i]), the xs pairwise distinct.
+    // Direct takes Newton divided differences; Tree sums the Lagrange form up the subproduct tree, its
+    // weights 1 / M'(xs[i]) for M the product of all (x - xs[i]) evaluated down the same tree.
+    // Monomial coefficients through many real points are ill-conditioned whichever way they are computed,
+    // and the tree loses more of them than the differences do, so it too runs only when asked for.
+    static CPolynomial interpolate(span<const double> xs, span<const double> ys,
+                                   EMultipoint method = EMultipoint::Direct){
+        size_t count = min(xs.size(), ys.size());
+        if (count == 0) return CPolynomial();
+        if (method == EMultipoint::Direct) {
+            vector<double> differences(ys.begin(), ys.begin() + count);
+            for (size_t j = 1; j < count; j++) {
+                for (size_t i = count - 1; i >= j; i--) {
+                    differences[i] = (differences[i] - differences[i - 1]) / (xs[i] - xs[i - j]);
+                }
+            }
+            // p = d[0] + (x - xs[0]) * (d[1] + (x - xs[1]) * (...))
+            vector<double> res(count, 0.0);
+            res[0] = differences[count - 1];
+            for (size_t k = count - 1; k-- > 0;) {
+                for (size_t i = count - 1 - k; i > 0; i--) {
+                    res[i] = res[i - 1] - xs[k] * res[i];
+                }
+                res[0] = differences[k] - xs[k] * res[0];
+            }
+            return fromCoefficients(std::move(res));
+        }
+        CSubproductTree tree(xs.first(count));
+        const vector<double>& root = tree.nodes[0];
+        vector<double> derivative(count), weights(count);
+        for (size_t i = 0; i < count; i++) {
+            derivative[i] = (i + 1) * root[i + 1];
+        }
+        evaluateTree(tree, std::move(derivative), 0, 0, count, weights);
+        for (size_t i = 0; i < count; i++) {
+            weights[i] = ys[i] / weights[i];
+        }
+        return fromCoefficients(combineTree(tree, weights, 0, 0, count));
+    }
+
     // Degree method
     size_t degree() const {
+        if (_sparse) {
+            for (auto it = _terms.rbegin(); it != _terms.rend(); ++it) {
+                if (it->second != 0.0) return it->first;
+            }
+            return 0;
+        }
         size_t i = _coefficients.size();
         while(i--) {
             if (_coefficients[i] != 0.0) {
@@ -202,14 +498,800 @@ public:
         for(double _coefficient : _coefficients){
             if(_coefficient != 0) return true;
         }
+        for (const Term & term : _terms) {
+            if (term.second != 0) return true;
+        }
         return false;
     }
     bool operator!() const{
         return !static_cast<bool>(*this);
     }
+
+    // Whether the terms are kept as (exponent, coefficient) pairs, decided by density
+    bool sparse() const{
+        return _sparse;
+    }
+    // The non-zero terms by increasing exponent
+    vector<Term> terms() const{
+        vector<Term> res;
+        if (_sparse) {
+            copy_if(_terms.begin(), _terms.end(), back_inserter(res), [](const Term & term){ return term.second != 0; });
+        } else {
+            for (size_t i = 0; i < _coefficients.size(); i++) {
+                if (_coefficients[i] != 0) res.emplace_back(i, _coefficients[i]);
+            }
+        }
+        return res;
+    }
+
+    // Product of two term lists sorted by exponent, as sorted terms without zeros. Products landing in a
+    // range not much wider than their count are summed in a dense window, others are sorted and merged.
+    static vector<Term> multiplySparse(const vector<Term> & a, const vector<Term> & b){
+        vector<Term> res;
+        if (a.empty() || b.empty()) return res;
+        size_t products = a.size() * b.size();
+        size_t low = a.front().first + b.front().first, span = a.back().first + b.back().first + 1 - low;
+        if (span <= SPARSE_SPAN * products) {
+            vector<double> window(span, 0.0);
+            for (const auto & [ea, ca] : a) {
+                for (const auto & [eb, cb] : b) {
+                    window[ea + eb - low] += ca * cb;
+                }
+            }
+            for (size_t i = 0; i < span; i++) {
+                if (window[i] != 0) res.emplace_back(low + i, window[i]);
+            }
+            return res;
+        }
+        vector<Term> all;
+        all.reserve(products);
+        for (const auto & [ea, ca] : a) {
+            for (const auto & [eb, cb] : b) {
+                all.emplace_back(ea + eb, ca * cb);
+            }
+        }
+        sort(all.begin(), all.end(), byExponent);
+        for (size_t i = 0; i < all.size();) {
+            Term sum = all[i];
+            while (++i < all.size() && all[i].first == sum.first) {
+                sum.second += all[i].second;
+            }
+            if (sum.second != 0) res.push_back(sum);
+        }
+        return res;
+    }
+
+    enum class EDivision { Adaptive, Schoolbook, Newton };
+
+    // Quotient and remainder of the division by divisor, the remainder of lower degree than the divisor.
+    // Long division while the quotient or the divisor is short, otherwise the quotient comes from
+    // a Newton-iteration reciprocal of the reversed divisor and fast multiplication.
+    // Throws domain_error for a zero divisor.
+    pair<CPolynomial, CPolynomial> divmod(const CPolynomial& divisor, EDivision method = EDivision::Adaptive) const{
+        if (!divisor) throw domain_error("Polynomial division by zero");
+        size_t n = degree(), m = divisor.degree();
+        if (n < m || !*this) return {CPolynomial(), *this};
+
+        auto [quotient, remainder] = divide(denseCoefficients(), divisor.denseCoefficients(), method);
+        return {fromCoefficients(std::move(quotient)), fromCoefficients(std::move(remainder))};
+    }
+    // Remainder of the division by divisor, as divmod gives it. A sparse dividend is reduced term by term,
+    // each x^e mod divisor a product of the squares x^(2^k) mod divisor, so memory follows the divisor's
+    // degree and the dividend's terms instead of the dividend's degree.
+    CPolynomial mod(const CPolynomial& divisor) const{
+        if (!divisor) throw domain_error("Polynomial division by zero");
+        size_t m = divisor.degree();
+        if (!_sparse || degree() < m) return divmod(divisor).second;
+        if (m == 0) return CPolynomial();
+
+        vector<double> d = divisor.denseCoefficients();
+        auto reduce = [&d, m](vector<double> v){
+            if (v.size() > m) return divide(std::move(v), d).second;
+            v.resize(m, 0.0);
+            return v;
+        };
+        vector<vector<double>> squares{reduce({0.0, 1.0})};
+        vector<double> res(m, 0.0);
+        for (auto [e, c] : _terms) {
+            if (c == 0.0) continue;
+            vector<double> power{1.0};
+            for (size_t k = 0; e >> k; k++) {
+                if (k == squares.size()) squares.push_back(reduce(multiply(squares.back(), squares.back())));
+                if ((e >> k) & 1) power = reduce(multiply(power, squares[k]));
+            }
+            for (size_t i = 0; i < power.size(); i++) {
+                res[i] += c * power[i];
+            }
+        }
+        return fromCoefficients(std::move(res));
+    }
+    // The same on coefficient vectors, a at least as long as b and b with a non-zero last coefficient;
+    // throws invalid_argument otherwise
+    static pair<vector<double>, vector<double>> divide(vector<double> a, span<const double> b,
+                                                       EDivision method = EDivision::Adaptive){
+        if (b.empty() || b.back() == 0.0 || a.size() < b.size()) {
+            throw invalid_argument("Dividend shorter than the divisor or divisor with a zero last coefficient");
+        }
+        size_t n = a.size() - 1, m = b.size() - 1, length = n - m + 1;
+        if (method == EDivision::Adaptive) {
+            method = min(length, m) < DIVISION_THRESHOLD ? EDivision::Schoolbook : EDivision::Newton;
+        }
+        vector<double> quotient(length);
+        if (method == EDivision::Schoolbook) {
+            for (size_t i = length; i-- > 0;) {
+                quotient[i] = a[i + m] / b[m];
+                for (size_t j = 0; j < m; j++) {
+                    a[i + j] -= quotient[i] * b[j];
+                }
+            }
+            a.resize(max<size_t>(m, 1));
+            if (m == 0) a[0] = 0.0;
+        } else {
+            // rev(quotient) = rev(a) / rev(b) mod x^length
+            vector<double> reversedA(a.rbegin(), a.rbegin() + length), reversedB(b.rbegin(), b.rend());
+            vector<double> reversedQ = multiply(reversedA, reciprocal(reversedB, length));
+            copy_n(reversedQ.begin(), length, quotient.rbegin());
+            vector<double> product = multiply(b, quotient);
+            for (size_t i = 0; i < m; i++) {
+                a[i] -= product[i];
+            }
+            a.resize(m);
+        }
+        return {std::move(quotient), std::move(a)};
+    }
+
+    // All complex roots, each as often as its multiplicity, by Aberth-Ehrlich iteration: each step moves
+    // a root by the Newton correction for p divided by the product of (x - z) over the other roots z.
+    // All roots move at once from the previous positions, in threadCount contiguous blocks of LANES roots
+    // that run across SIMD lanes on workers kept for the whole iteration. A root stops once its step is below
+    // tolerance relative to its modulus, or once p at it is down to the rounding error of evaluating p there:
+    // multiple roots converge slowly and only to about the square root of the precision, their steps then
+    // wander in the rounding noise. Throws domain_error for the zero polynomial and runtime_error when some
+    // root meets neither test within ROOTS_ITERATIONS steps.
+    vector<complex<double>> roots(double tolerance = 1e-12, size_t threadCount = 1) const{
+        if (!*this) throw domain_error("Roots of the zero polynomial");
+        vector<double> a = denseCoefficients();
+        size_t zeros = 0;
+        while (a[zeros] == 0.0) zeros++;
+        a.erase(a.begin(), a.begin() + zeros);
+        vector<complex<double>> res(zeros, 0.0);
+        size_t n = a.size() - 1;
+        if (n == 0) return res;
+
+        // Start evenly on the circle of the geometric mean modulus of the roots, off the real axis
+        size_t padded = (n + LANES - 1) / LANES * LANES;
+        vector<double> re(padded, 0.0), im(padded, 0.0), stepRe(padded), stepIm(padded), noise(padded);
+        vector<char> done(padded, true);
+        double radius = pow(abs(a[0] / a[n]), 1.0 / n);
+        for (size_t k = 0; k < n; k++) {
+            double angle = 2 * M_PI * k / n + 0.4;
+            re[k] = radius * cos(angle);
+            im[k] = radius * sin(angle);
+            done[k] = false;
+        }
+        // Each worker steps its block, waits for all the steps, moves its block and waits for all the moves
+        size_t block = (padded / clamp<size_t>(threadCount, 1, padded / LANES) + LANES - 1) / LANES * LANES;
+        size_t workers = (padded + block - 1) / block, iteration = 0;
+        atomic<size_t> left = n;
+        bool moving = false, stop = false;
+        barrier sync(ptrdiff_t(workers), [&]() noexcept {
+            if (moving && (left == 0 || ++iteration == ROOTS_ITERATIONS)) stop = true;
+            moving = !moving;
+        });
+        auto run = [&](size_t from, size_t to){
+            while (true) {
+                for (size_t k = from; k < to; k += LANES) {
+                    if (!all_of(done.begin() + k, done.begin() + k + LANES, [](char d){ return d; })) {
+                        aberthLanes(a.data(), n, re.data(), im.data(), k, stepRe.data(), stepIm.data(), noise.data());
+                    }
+                }
+                sync.arrive_and_wait();
+                for (size_t k = from; k < min(to, n); k++) {
+                    if (done[k]) continue;
+                    if (noise[k] <= DBL_EPSILON * DBL_EPSILON) {
+                        done[k] = true;
+                        left--;
+                        continue;
+                    }
+                    re[k] -= stepRe[k];
+                    im[k] -= stepIm[k];
+                    double step = stepRe[k] * stepRe[k] + stepIm[k] * stepIm[k];
+                    if (step <= tolerance * tolerance * (re[k] * re[k] + im[k] * im[k])) {
+                        done[k] = true;
+                        left--;
+                    }
+                }
+                sync.arrive_and_wait();
+                if (stop) return;
+            }
+        };
+        vector<thread> threads;
+        for (size_t from = block; from < padded; from += block) {
+            threads.emplace_back(run, from, min(from + block, padded));
+        }
+        run(0, min(block, padded));
+        for (thread & th : threads) {
+            th.join();
+        }
+        if (left > 0) throw runtime_error("Roots did not converge");
+        for (size_t k = 0; k < n; k++) {
+            res.emplace_back(re[k], im[k]);
+        }
+        return res;
+    }
+
+    // The power series 1 / f mod x^count by Newton iteration, doubling the correct terms each step; f[0] != 0
+    static vector<double> reciprocal(span<const double> f, size_t count){
+        vector<double> g{1.0 / f[0]};
+        for (size_t known = 1; known < count;) {
+            known = min(2 * known, count);
+            // g += g * (1 - f * g) mod x^known
+            vector<double> error = multiply(f.first(min(known, f.size())), g);
+            error.resize(known, 0.0);
+            for (double& e : error) {
+                e = -e;
+            }
+            error[0] += 1.0;
+            vector<double> correction = multiply(g, error);
+            g.resize(known, 0.0);
+            for (size_t i = 0; i < known; i++) {
+                g[i] += correction[i];
+            }
+        }
+        return g;
+    }
+
+    enum class EKernel { Adaptive, Schoolbook, Karatsuba, FFT };
+
+    // Product of two coefficient vectors: schoolbook while the shorter one is tiny, Karatsuba for mid sizes
+    // and an FFT convolution for large ones. The FFT result is accurate to rounding, not exact.
+    static vector<double> multiply(span<const double> a, span<const double> b, EKernel kernel = EKernel::Adaptive,
+                                   double scale = 1.0){
+        vector<double> res(a.size() + b.size() - 1, 0.0);
+        multiplyInto(a, b, res, kernel, scale);
+        return res;
+    }
+    // The same, adding into res of a.size() + b.size() - 1 values
+    static void multiplyInto(span<const double> a, span<const double> b, span<double> res,
+                             EKernel kernel = EKernel::Adaptive, double scale = 1.0){
+        if (a.size() > b.size()) swap(a, b);
+        if (kernel == EKernel::Adaptive) {
+            kernel = a.size() <= KARATSUBA_THRESHOLD ? EKernel::Schoolbook
+                   : a.size() < FFT_THRESHOLD ? EKernel::Karatsuba : EKernel::FFT;
+        }
+        if (kernel == EKernel::Schoolbook) {
+            mulSchoolbook(a, b, res, scale);
+        } else if (kernel == EKernel::FFT) {
+            mulFFT(a, b, res, scale);
+        } else {
+            mulKaratsuba(a, b, res, scale);
+        }
+    }
+
+private:
+    explicit CPolynomial(CCoefficients&& coefficients): _coefficients(std::move(coefficients)){}
+
+    // Sparse once the exponents span more than SPARSE_SPAN slots per non-zero term, dense again below
+    // DENSE_SPAN; polynomials of degree below SPARSE_MIN always stay dense
+    static constexpr size_t SPARSE_SPAN = 16;
+    static constexpr size_t DENSE_SPAN = 4;
+    static constexpr size_t SPARSE_MIN = 64;
+
+    static bool byExponent(const Term & a, const Term & b){
+        return a.first < b.first;
+    }
+    vector<Term>::const_iterator findTerm(size_t exponent) const{
+        auto it = lower_bound(_terms.begin(), _terms.end(), Term(exponent, 0.0), byExponent);
+        return it != _terms.end() && it->first == exponent ? it : _terms.end();
+    }
+    size_t nonzeroCount() const{
+        if (_sparse) {
+            return count_if(_terms.begin(), _terms.end(), [](const Term & term){ return term.second != 0; });
+        }
+        return _coefficients.size() - count(_coefficients.begin(), _coefficients.end(), 0.0);
+    }
+    void toSparse(){
+        _terms = terms();
+        _coefficients = {};
+        _sparse = true;
+    }
+    void toDense(){
+        _coefficients.assign(degree() + 1, 0.0);
+        for (const auto & [e, c] : _terms) {
+            if (c != 0) _coefficients[e] = c;
+        }
+        _terms = {};
+        _sparse = false;
+    }
+    vector<double> denseCoefficients() const{
+        vector<double> res(degree() + 1, 0.0);
+        if (_sparse) {
+            for (const auto & [e, c] : _terms) {
+                if (e < res.size()) res[e] = c;
+            }
+        } else {
+            copy_n(_coefficients.begin(), res.size(), res.begin());
+        }
+        return res;
+    }
+    static CPolynomial fromCoefficients(vector<double>&& coefficients){
+        CPolynomial res(CCoefficients(std::move(coefficients)));
+        if (res._coefficients.empty()) res._coefficients.assign(1, 0.0);
+        res.normalize();
+        return res;
+    }
+
+    void makeZero() noexcept{
+        _coefficients.assign(1, 0.0);
+        _terms.clear();
+        _sparse = false;
+    }
+
+    // Picks the representation that suits the current density
+    void normalize(){
+        size_t span = degree() + 1, count = nonzeroCount();
+        if (_sparse && span < max(SPARSE_MIN, DENSE_SPAN * count)) {
+            toDense();
+        } else if (!_sparse && span >= SPARSE_MIN && span > SPARSE_SPAN * count) {
+            toSparse();
+        }
+    }
+
+    // Products of (x - xs[i]) over the points in [from, to) of node k, whose halves are nodes 2k + 1 and 2k + 2
+    struct CSubproductTree {
+        span<const double> xs;
+        vector<vector<double>> nodes;
+
+        explicit CSubproductTree(span<const double> points): xs(points), nodes(4 * points.size()) {
+            build(0, 0, points.size());
+        }
+        void build(size_t k, size_t from, size_t to){
+            if (to - from == 1) {
+                nodes[k] = {-xs[from], 1.0};
+                return;
+            }
+            size_t mid = from + (to - from) / 2;
+            build(2 * k + 1, from, mid);
+            build(2 * k + 2, mid, to);
+            nodes[k] = multiply(nodes[2 * k + 1], nodes[2 * k + 2]);
+        }
+    };
+
+    // Values of p at the points of node k, p first reduced modulo the node's product
+    static void evaluateTree(const CSubproductTree& tree, vector<double> p, size_t k, size_t from, size_t to,
+                             span<double> out){
+        if (p.size() > to - from) {
+            p = divide(std::move(p), tree.nodes[k]).second;
+        }
+        if (to - from <= MULTIPOINT_LEAF) {
+            for (; from + LANES <= to; from += LANES) {
+                evaluateLanes(false, p.data(), p.size(), tree.xs.data() + from, out.data() + from);
+            }
+            if (from < to) {
+                double x[LANES] = {}, res[LANES];
+                copy(tree.xs.begin() + from, tree.xs.begin() + to, x);
+                evaluateLanes(false, p.data(), p.size(), x, res);
+                copy(res, res + (to - from), out.begin() + from);
+            }
+            return;
+        }
+        size_t mid = from + (to - from) / 2;
+        evaluateTree(tree, p, 2 * k + 1, from, mid, out);
+        evaluateTree(tree, std::move(p), 2 * k + 2, mid, to, out);
+    }
+
+    // Sum of weights[i] * M(x) / (x - xs[i]) over the points of node k, M the node's product
+    static vector<double> combineTree(const CSubproductTree& tree, span<const double> weights, size_t k,
+                                      size_t from, size_t to){
+        if (to - from == 1) return {weights[from]};
+        size_t mid = from + (to - from) / 2;
+        vector<double> res = multiply(combineTree(tree, weights, 2 * k + 1, from, mid), tree.nodes[2 * k + 2]);
+        vector<double> right = multiply(combineTree(tree, weights, 2 * k + 2, mid, to), tree.nodes[2 * k + 1]);
+        for (size_t i = 0; i < right.size(); i++) {
+            res[i] += right[i];
+        }
+        return res;
+    }
+
+    // Below this many points a remainder is cheaper to evaluate directly than to split further
+    static constexpr size_t MULTIPOINT_LEAF = 64;
+
+    // Aberth iteration gives up, and roots throws, when some root has not converged after this many steps
+    static constexpr size_t ROOTS_ITERATIONS = 500;
+
+    // Newton division once both the quotient and the divisor are this long, chosen by benchmarkDivision
+    static constexpr size_t DIVISION_THRESHOLD = 1280;
+
+    // Thresholds on the length of the shorter operand, chosen by benchmarkMultiply
+    static constexpr size_t KARATSUBA_THRESHOLD = 32;
+    static constexpr size_t FFT_THRESHOLD = 448;
+
+    // Each kernel adds scale * a * b to res, which holds a.size() + b.size() - 1 values
+    static void mulSchoolbook(span<const double> a, span<const double> b, span<double> res, double scale = 1.0){
+        for (size_t i = 0; i < a.size(); i++) {
+            double ai = a[i] * scale;
+            double * row = res.data() + i;
+            for (size_t j = 0; j < b.size(); j++) {
+                row[j] += ai * b[j];
+            }
+        }
+    }
+
+    // The longer operand is cut into blocks as long as the shorter one, each pair of equal halves recurses
+    static void mulKaratsuba(span<const double> a, span<const double> b, span<double> res, double scale){
+        size_t n = a.size();
+        vector<double> block(n), product(2 * n - 1), scratch(karatsubaScratch(n));
+        for (size_t from = 0; from < b.size(); from += n) {
+            size_t length = min(n, b.size() - from);
+            transform(b.begin() + from, b.begin() + from + length, block.begin(), [scale](double c){ return c * scale; });
+            fill(block.begin() + length, block.end(), 0.0);
+            fill(product.begin(), product.end(), 0.0);
+            karatsuba(a.data(), block.data(), n, product.data(), scratch.data());
+            for (size_t i = 0; i < n + length - 1; i++) {
+                res[from + i] += product[i];
+            }
+        }
+    }
+    static size_t karatsubaScratch(size_t n){
+        size_t size = 0;
+        for (; n > KARATSUBA_THRESHOLD; n -= n / 2) {
+            size_t high = n - n / 2;
+            size += 2 * high + 3 * (2 * high - 1);
+        }
+        return size;
+    }
+    // res += a * b for a and b of n values, res of 2n - 1
+    static void karatsuba(const double * a, const double * b, size_t n, double * res, double * scratch){
+        if (n <= KARATSUBA_THRESHOLD) {
+            mulSchoolbook({a, n}, {b, n}, {res, 2 * n - 1});
+            return;
+        }
+        size_t low = n / 2, high = n - low;
+        double * sumA = scratch, * sumB = sumA + high;
+        double * z0 = sumB + high, * z1 = z0 + 2 * high - 1, * z2 = z1 + 2 * high - 1;
+        double * rest = z2 + 2 * high - 1;
+        fill(z0, rest, 0.0);
+        for (size_t i = 0; i < high; i++) {
+            sumA[i] = a[low + i] + (i < low ? a[i] : 0.0);
+            sumB[i] = b[low + i] + (i < low ? b[i] : 0.0);
+        }
+        karatsuba(a, b, low, z0, rest);
+        karatsuba(a + low, b + low, high, z2, rest);
+        karatsuba(sumA, sumB, high, z1, rest);
+        for (size_t i = 0; i < 2 * low - 1; i++) {
+            res[i] += z0[i];
+            z1[i] -= z0[i];
+        }
+        for (size_t i = 0; i < 2 * high - 1; i++) {
+            res[2 * low + i] += z2[i];
+            res[low + i] += z1[i] - z2[i];
+        }
+    }
+
+    // Both real operands go through one complex transform as its real and imaginary parts
+    static void mulFFT(span<const double> a, span<const double> b, span<double> res, double scale){
+        size_t size = bit_ceil(res.size());
+        vector<complex<double>> packed(size), product(size);
+        for (size_t i = 0; i < a.size(); i++) {
+            packed[i].real(a[i]);
+        }
+        for (size_t i = 0; i < b.size(); i++) {
+            packed[i].imag(b[i]);
+        }
+        fft(packed, false);
+        // With C = A + iB, A * B = (C[k]^2 - conj(C[-k])^2) / 4i
+        for (size_t k = 0; k < size; k++) {
+            complex<double> c = packed[k], d = conj(packed[(size - k) & (size - 1)]);
+            complex<double> diff = mul(c, c) - mul(d, d);
+            product[k] = {diff.imag() / 4, -diff.real() / 4};
+        }
+        fft(product, true);
+        for (size_t i = 0; i < res.size(); i++) {
+            res[i] += product[i].real() * (scale / size);
+        }
+    }
+    // Iterative radix-2 transform, unscaled in both directions
+    static void fft(vector<complex<double>> & data, bool inverse){
+        size_t size = data.size();
+        for (size_t i = 1, j = 0; i < size; i++) {
+            size_t bit = size >> 1;
+            for (; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j) swap(data[i], data[j]);
+        }
+        vector<complex<double>> roots(size / 2);
+        for (size_t k = 0; k < size / 2; k++) {
+            double angle = 2 * M_PI * k / size;
+            roots[k] = {cos(angle), inverse ? sin(angle) : -sin(angle)};
+        }
+        for (size_t length = 2; length <= size; length <<= 1) {
+            size_t step = size / length;
+            for (size_t i = 0; i < size; i += length) {
+                for (size_t j = 0; j < length / 2; j++) {
+                    complex<double> u = data[i + j], v = mul(data[i + j + length / 2], roots[j * step]);
+                    data[i + j] = u + v;
+                    data[i + j + length / 2] = u - v;
+                }
+            }
+        }
+    }
+    // Points evaluated together by one kernel call, two AVX-512 or four AVX2 registers
+    static constexpr size_t LANES = 16;
+    // Estrin evaluates blocks of this many coefficients, from this degree on, chosen by benchmarkEvaluate
+    static constexpr size_t ESTRIN_BLOCK = 16;
+    static constexpr size_t ESTRIN_DEGREE = 48;
+
+    // One kernel call for LANES points, compiled for each instruction set and picked by the CPU at run time
+    static void evaluateLanes(bool estrin, const double * coefficients, size_t count, const double * xs, double * res){
+#if defined(__x86_64__)
+        static const int isa = __builtin_cpu_supports("avx512f") ? 2 : __builtin_cpu_supports("avx2") ? 1 : 0;
+        if (isa == 2) return evaluateAvx512(estrin, coefficients, count, xs, res);
+        if (isa == 1) return evaluateAvx2(estrin, coefficients, count, xs, res);
+#endif
+        estrin ? estrinLanes(coefficients, count, xs, res) : hornerLanes(coefficients, count, xs, res);
+    }
+#if defined(__x86_64__)
+    __attribute__((target("avx512f")))
+    static void evaluateAvx512(bool estrin, const double * coefficients, size_t count, const double * xs, double * res){
+        estrin ? estrinLanes(coefficients, count, xs, res) : hornerLanes(coefficients, count, xs, res);
+    }
+    __attribute__((target("avx2")))
+    static void evaluateAvx2(bool estrin, const double * coefficients, size_t count, const double * xs, double * res){
+        estrin ? estrinLanes(coefficients, count, xs, res) : hornerLanes(coefficients, count, xs, res);
+    }
+#endif
+    // The loops over lanes have a fixed trip count, inlined into a kernel they vectorize for its instruction set
+    [[gnu::always_inline]] static void hornerLanes(const double * coefficients, size_t count, const double * xs, double * res){
+        double acc[LANES];
+        for (size_t l = 0; l < LANES; l++) {
+            acc[l] = coefficients[count - 1];
+        }
+        for (size_t i = count - 1; i-- > 0;) {
+            double c = coefficients[i];
+            for (size_t l = 0; l < LANES; l++) {
+                acc[l] = acc[l] * xs[l] + c;
+            }
+        }
+        copy(acc, acc + LANES, res);
+    }
+    // blockCount blocks of ESTRIN_BLOCK coefficients, Horner in x^16 over the blocks
+    [[gnu::always_inline]] static void estrinLanes(const double * coefficients, size_t blockCount, const double * xs, double * res){
+        static_assert(ESTRIN_BLOCK == 16);
+        double x2[LANES], x4[LANES], x8[LANES], x16[LANES], acc[LANES] = {};
+        for (size_t l = 0; l < LANES; l++) {
+            x2[l] = xs[l] * xs[l];
+            x4[l] = x2[l] * x2[l];
+            x8[l] = x4[l] * x4[l];
+            x16[l] = x8[l] * x8[l];
+        }
+        for (size_t b = blockCount; b-- > 0;) {
+            const double * c = coefficients + b * ESTRIN_BLOCK;
+            for (size_t l = 0; l < LANES; l++) {
+                double x = xs[l];
+                double p0 = c[0] + c[1] * x, p1 = c[2] + c[3] * x, p2 = c[4] + c[5] * x, p3 = c[6] + c[7] * x;
+                double p4 = c[8] + c[9] * x, p5 = c[10] + c[11] * x, p6 = c[12] + c[13] * x, p7 = c[14] + c[15] * x;
+                double q0 = p0 + p1 * x2[l], q1 = p2 + p3 * x2[l], q2 = p4 + p5 * x2[l], q3 = p6 + p7 * x2[l];
+                double r0 = q0 + q1 * x4[l], r1 = q2 + q3 * x4[l];
+                acc[l] = acc[l] * x16[l] + (r0 + r1 * x8[l]);
+            }
+        }
+        copy(acc, acc + LANES, res);
+    }
+
+    // Aberth steps for the LANES roots from index k of the n roots in re and im, a the n + 1 coefficients;
+    // noise gets |p(z)|^2 over the square of its rounding bound, the sum of |a_i z^i|
+    static void aberthLanes(const double * a, size_t n, const double * re, const double * im, size_t k,
+                            double * stepRe, double * stepIm, double * noise){
+#if defined(__x86_64__)
+        static const int isa = __builtin_cpu_supports("avx512f") ? 2 : __builtin_cpu_supports("avx2") ? 1 : 0;
+        if (isa == 2) return aberthAvx512(a, n, re, im, k, stepRe, stepIm, noise);
+        if (isa == 1) return aberthAvx2(a, n, re, im, k, stepRe, stepIm, noise);
+#endif
+        aberthKernel(a, n, re, im, k, stepRe, stepIm, noise);
+    }
+#if defined(__x86_64__)
+    __attribute__((target("avx512f")))
+    static void aberthAvx512(const double * a, size_t n, const double * re, const double * im, size_t k,
+                             double * stepRe, double * stepIm, double * noise){
+        aberthKernel(a, n, re, im, k, stepRe, stepIm, noise);
+    }
+    __attribute__((target("avx2")))
+    static void aberthAvx2(const double * a, size_t n, const double * re, const double * im, size_t k,
+                           double * stepRe, double * stepIm, double * noise){
+        aberthKernel(a, n, re, im, k, stepRe, stepIm, noise);
+    }
+#endif
+    // The step is P / (D - P * S) for P = p(z), D = p'(z) and S the sum of 1 / (z - z_j) over the other roots.
+    // Outside the unit circle P = q(w) and D = w * (n * q(w) - w * q'(w)) instead, q the reversed polynomial
+    // and w = 1 / z, which scales both by w^n and keeps the powers from overflowing.
+    [[gnu::always_inline]] static void aberthKernel(const double * a, size_t n, const double * re, const double * im,
+                                                    size_t k, double * stepRe, double * stepIm, double * noise){
+        // Selects compare doubles to doubles, a mask of another width would keep the lanes from vectorizing
+        double zr[LANES], zi[LANES], norm[LANES], pr[LANES] = {}, pi[LANES] = {}, dr[LANES] = {}, di[LANES] = {};
+        double modulus[LANES], bound[LANES] = {};
+        for (size_t l = 0; l < LANES; l++) {
+            norm[l] = re[k + l] * re[k + l] + im[k + l] * im[k + l];
+            zr[l] = norm[l] > 1.0 ? re[k + l] / norm[l] : re[k + l];
+            zi[l] = norm[l] > 1.0 ? -im[k + l] / norm[l] : im[k + l];
+            modulus[l] = sqrt(zr[l] * zr[l] + zi[l] * zi[l]);
+        }
+        for (size_t i = 0; i <= n; i++) {
+            double forward = a[n - i], reversed = a[i];
+            for (size_t l = 0; l < LANES; l++) {
+                double c = norm[l] > 1.0 ? reversed : forward;
+                double r = dr[l] * zr[l] - di[l] * zi[l] + pr[l], s = dr[l] * zi[l] + di[l] * zr[l] + pi[l];
+                dr[l] = r;
+                di[l] = s;
+                r = pr[l] * zr[l] - pi[l] * zi[l] + c;
+                s = pr[l] * zi[l] + pi[l] * zr[l];
+                pr[l] = r;
+                pi[l] = s;
+                bound[l] = bound[l] * modulus[l] + abs(c);
+            }
+        }
+        // The root itself adds 0 / DBL_MIN, a division without a branch around it vectorizes on every target
+        double sr[LANES] = {}, si[LANES] = {};
+        for (size_t j = 0; j < n; j++) {
+            double xr = re[j], xi = im[j];
+            for (size_t l = 0; l < LANES; l++) {
+                double ur = re[k + l] - xr, ui = im[k + l] - xi;
+                double inv = 1.0 / (ur * ur + ui * ui + DBL_MIN);
+                sr[l] += ur * inv;
+                si[l] -= ui * inv;
+            }
+        }
+        for (size_t l = 0; l < LANES; l++) {
+            double Dr = dr[l], Di = di[l];
+            if (norm[l] > 1.0) {
+                double ur = n * pr[l] - (zr[l] * dr[l] - zi[l] * di[l]), ui = n * pi[l] - (zr[l] * di[l] + zi[l] * dr[l]);
+                Dr = zr[l] * ur - zi[l] * ui;
+                Di = zr[l] * ui + zi[l] * ur;
+            }
+            double er = Dr - (pr[l] * sr[l] - pi[l] * si[l]), ei = Di - (pr[l] * si[l] + pi[l] * sr[l]);
+            double norm = max(er * er + ei * ei, DBL_MIN);
+            stepRe[k + l] = (pr[l] * er + pi[l] * ei) / norm;
+            stepIm[k + l] = (pi[l] * er - pr[l] * ei) / norm;
+            noise[k + l] = (pr[l] * pr[l] + pi[l] * pi[l]) / (bound[l] * bound[l]);
+        }
+    }
+
+    // Plain complex product, without the NaN recovery of operator*
+    static complex<double> mul(complex<double> a, complex<double> b){
+        return {a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real()};
+    }
+};
+
+// Products; a temporary operand is scaled in place and keeps its buffer
+inline CPolynomial operator*(const CPolynomial& p, double scalar){
+    CPolynomial res(p);
+    res *= scalar;
+    return res;
+}
+inline CPolynomial operator*(CPolynomial&& p, double scalar){
+    p *= scalar;
+    return std::move(p);
+}
+inline CPolynomial operator*(double scalar, const CPolynomial& p){
+    return p * scalar;
+}
+inline CPolynomial operator*(double scalar, CPolynomial&& p){
+    return std::move(p) * scalar;
+}
+inline CPolynomial operator*(const CPolynomial& a, const CPolynomial& b){
+    return CPolynomial::product(a, b, 1.0);
+}
+
+// Polynomial of degree at most N fixed at compile time, coefficients lowest first as with CPolynomial.
+// Everything but the conversions is constexpr, so filters built from constants fold at compile time.
+template <size_t N>
+class CStaticPolynomial {
+public:
+    constexpr CStaticPolynomial() = default;
+    template <typename... T> requires (sizeof...(T) <= N + 1 && (is_convertible_v<T, double> && ...))
+    constexpr explicit CStaticPolynomial(T... coefficients): _coefficients{static_cast<double>(coefficients)...}{}
+    // Throws length_error if other does not fit degree N
+    explicit CStaticPolynomial(const CPolynomial& other){
+        if (other.degree() > N) throw length_error("Polynomial degree exceeds " + to_string(N));
+        for (size_t i = 0; i <= N; i++) {
+            _coefficients[i] = other[i];
+        }
+    }
+    operator CPolynomial() const{
+        CPolynomial res;
+        for (size_t i = degree() + 1; i-- > 0;) {
+            res[i] = _coefficients[i];
+        }
+        return res;
+    }
+
+    // The degree cannot grow, throws out_of_range past N
+    constexpr double& operator[](size_t index){
+        if (index > N) throw out_of_range("Coefficient index exceeds " + to_string(N));
+        return _coefficients[index];
+    }
+    constexpr double operator[](size_t index) const{
+        return index <= N ? _coefficients[index] : 0.0;
+    }
+    // Horner unrolled over all N + 1 coefficients
+    constexpr double operator()(double x) const{
+        return horner(x, make_index_sequence<N + 1>{});
+    }
+    constexpr size_t degree() const{
+        for (size_t i = N; i > 0; i--) {
+            if (_coefficients[i] != 0.0) return i;
+        }
+        return 0;
+    }
+
+    template <size_t M>
+    constexpr CStaticPolynomial<N + M> operator*(const CStaticPolynomial<M>& other) const{
+        CStaticPolynomial<N + M> res;
+        for (size_t i = 0; i <= N; i++) {
+            for (size_t j = 0; j <= M; j++) {
+                res[i + j] += _coefficients[i] * other[j];
+            }
+        }
+        return res;
+    }
+    constexpr CStaticPolynomial operator*(double scalar) const{
+        CStaticPolynomial res(*this);
+        for (double& c : res._coefficients) {
+            c *= scalar;
+        }
+        return res;
+    }
+    friend constexpr CStaticPolynomial operator*(double scalar, const CStaticPolynomial& p){
+        return p * scalar;
+    }
+    template <size_t M>
+    constexpr bool operator==(const CStaticPolynomial<M>& other) const{
+        for (size_t i = 0; i <= max(N, M); i++) {
+            if ((*this)[i] != other[i]) return false;
+        }
+        return true;
+    }
+private:
+    template <size_t... I>
+    constexpr double horner(double x, index_sequence<I...>) const{
+        double res = 0.0;
+        ((res = res * x + _coefficients[N - I]), ...);
+        return res;
+    }
+
+    double _coefficients[N + 1] = {};
 };
 
+// Division, see CPolynomial::divmod and CPolynomial::mod
+inline CPolynomial operator/(const CPolynomial& dividend, const CPolynomial& divisor){
+    return dividend.divmod(divisor).first;
+}
+inline CPolynomial operator%(const CPolynomial& dividend, const CPolynomial& divisor){
+    return dividend.mod(divisor);
+}
+
 #ifndef __PROGTEST__
+// Counts every global allocation, so tests can check how often a code path allocates.
+// Both deletes are ours, as a sanitizer's sized delete would reject this malloc, and out of line,
+// as an inlined free() next to operator new trips -Wmismatched-new-delete.
+atomic<size_t> allocationCount = 0;
+
+void * operator new (size_t size)
+{
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if(void * ptr = malloc(size ? size : 1)) return ptr;
+    throw bad_alloc();
+}
+[[gnu::noinline]] void operator delete (void * ptr) noexcept
+{
+    free(ptr);
+}
+[[gnu::noinline]] void operator delete (void * ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
 bool smallDiff(double a, double b) {
     return std::abs(a - b) <= 0.001 * std::max(std::abs(a), std::abs(b));
 }
@@ -224,8 +1306,730 @@ bool dumpMatch ( const CPolynomial & x,
     return b == x;
 }
 
-int main ()
+// Naive product, the reference for the fast kernels
+vector<double> naiveProduct(const vector<double> & a, const vector<double> & b){
+    vector<double> res(a.size() + b.size() - 1, 0.0);
+    for (size_t i = 0; i < a.size(); i++) {
+        for (size_t j = 0; j < b.size(); j++) {
+            res[i + j] += a[i] * b[j];
+        }
+    }
+    return res;
+}
+
+vector<double> randomCoefficients(size_t count, mt19937 & rng, bool integral){
+    uniform_real_distribution<double> real(-1.0, 1.0);
+    vector<double> res(count);
+    for (double & c : res) {
+        c = integral ? double(int(rng() % 21) - 10) : real(rng);
+    }
+    res.back() = 1.0;
+    return res;
+}
+
+void testMultiply(){
+    mt19937 rng(17);
+    // Small integers stay exact in schoolbook and Karatsuba, around and across the thresholds
+    for (auto [n, m] : vector<pair<size_t, size_t>>{{1, 1}, {5, 40}, {33, 33}, {47, 200}, {100, 101}, {300, 77}, {447, 447}}) {
+        vector<double> a = randomCoefficients(n, rng, true), b = randomCoefficients(m, rng, true);
+        assert ( CPolynomial::multiply(a, b) == naiveProduct(a, b) );
+        assert ( CPolynomial::multiply(a, b, CPolynomial::EKernel::Karatsuba) == naiveProduct(a, b) );
+    }
+    // The FFT agrees with the naive product to rounding
+    for (auto [n, m] : vector<pair<size_t, size_t>>{{1, 1}, {3, 90}, {512, 512}, {600, 3000}, {4000, 4001}}) {
+        vector<double> a = randomCoefficients(n, rng, false), b = randomCoefficients(m, rng, false);
+        vector<double> fast = CPolynomial::multiply(a, b, CPolynomial::EKernel::FFT), naive = naiveProduct(a, b);
+        for (size_t i = 0; i < naive.size(); i++) {
+            assert ( abs(fast[i] - naive[i]) <= 1e-10 * sqrt(double(min(n, m))) );
+        }
+    }
+    CPolynomial a, b;
+    for (size_t i = 0; i < 2000; i++) {
+        a[i] = double(i % 7);
+        b[i] = 1.0;
+    }
+    b[5000] = 0.0;
+    a *= b;
+    assert ( a.degree() == 3998 && smallDiff(a[3998], 4) && smallDiff(a[1000], 3003) );
+}
+
+// Time of one product of two operands of each size per kernel, where the thresholds come from
+void benchmarkMultiply(){
+    using EKernel = CPolynomial::EKernel;
+    mt19937 rng(17);
+    auto measure = [](auto && product){
+        auto start = chrono::steady_clock::now();
+        size_t rounds = 0;
+        do {
+            product();
+            rounds++;
+        } while (chrono::steady_clock::now() - start < chrono::milliseconds(200));
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds;
+    };
+    cout << setw(9) << "size";
+    for (const char * name : {"schoolbook", "karatsuba", "fft", "adaptive"}) {
+        cout << setw(14) << name;
+    }
+    cout << endl << fixed << setprecision(1);
+    for (size_t n : {8, 16, 32, 64, 128, 256, 384, 512, 1024, 4096, 65536, 1 << 20}) {
+        vector<double> a = randomCoefficients(n, rng, false), b = randomCoefficients(n, rng, false);
+        cout << setw(9) << n;
+        for (EKernel kernel : {EKernel::Schoolbook, EKernel::Karatsuba, EKernel::FFT, EKernel::Adaptive}) {
+            bool slow = (kernel == EKernel::Schoolbook && n > 65536) || (kernel == EKernel::Karatsuba && n > 65536);
+            if (slow) {
+                cout << setw(14) << "-";
+            } else {
+                cout << setw(12) << measure([&]{ CPolynomial::multiply(a, b, kernel); }) * 1e6 << "us";
+            }
+        }
+        cout << endl;
+    }
+}
+
+void testEvaluate(){
+    mt19937 rng(18);
+    for (size_t degree : {0, 3, 7, 47, 48, 60, 300}) {
+        CPolynomial p;
+        vector<double> coefficients = randomCoefficients(degree + 1, rng, false);
+        for (size_t i = 0; i <= degree; i++) {
+            p[i] = coefficients[i];
+        }
+        p[degree + 5] = 0.0;
+        uniform_real_distribution<double> point(-1.1, 1.1);
+        vector<double> xs(1000 + degree);
+        for (double & x : xs) {
+            x = point(rng);
+        }
+        for (auto scheme : {CPolynomial::EScheme::Auto, CPolynomial::EScheme::Horner, CPolynomial::EScheme::Estrin}) {
+            for (size_t threads : {1, 3}) {
+                vector<double> out(xs.size(), NAN);
+                p.evaluate(xs, out, threads, scheme);
+                for (size_t i = 0; i < xs.size(); i++) {
+                    assert ( abs(out[i] - p(xs[i])) <= 1e-12 * (degree + 1) * pow(1.1, degree) );
+                }
+            }
+        }
+    }
+    CPolynomial p;
+    vector<double> out(2, 1.0);
+    p.evaluate(vector<double>{2.0, 3.0}, out);
+    assert ( out[0] == 0.0 && out[1] == 0.0 );
+    p.evaluate({}, {});
+}
+
+void testSparse(){
+    CPolynomial a, b;
+    a[1000000] = 1;
+    a[0] = 1;
+    assert ( a.sparse() && a.degree() == 1000000 && a[999999] == 0.0 && a[1000000] == 1.0 );
+    b[1000000] = 1;
+    b[0] = -1;
+    ostringstream out;
+    out << b;
+    assert ( out.str() == "x^1000000 - 1" );
+    assert ( a(1.0) == 2.0 && b(-1.0) == 0.0 && smallDiff(a(1.000001), 1 + exp(1.0)) );
+
+    // (x^n + 1)(x^n - 1) = x^2n - 1 and the product of a sparse and a dense operand
+    CPolynomial c = a * b;
+    assert ( c.sparse() && c.terms() == (vector<CPolynomial::Term>{{0, -1.0}, {2000000, 1.0}}) );
+    CPolynomial d;
+    d[0] = 1;
+    d[1] = 2;
+    d[2] = 3;
+    c = a * d;
+    assert ( c.sparse() && c.terms() == (vector<CPolynomial::Term>{{0, 1.0}, {1, 2.0}, {2, 3.0}, {1000000, 1.0}, {1000001, 2.0}, {1000002, 3.0}}) );
+    c *= 0;
+    assert ( !c.sparse() && !c && c.degree() == 0 );
+
+    // Equality across representations, and the switch back once the terms fill in
+    CPolynomial dense, sparse;
+    for (size_t i = 0; i < 100; i++) {
+        dense[i] = double(i % 3);
+    }
+    for (size_t i = 100; i-- > 0;) {
+        sparse[i * 1000] = 1;
+        sparse[i * 1000] = 0;
+    }
+    assert ( sparse.sparse() && !sparse && sparse.degree() == 0 && sparse == CPolynomial() );
+    for (size_t i = 0; i < 100; i++) {
+        sparse[i] = double(i % 3);
+    }
+    assert ( sparse == dense && !dense.sparse() );
+    vector<CPolynomial::Term> terms = dense.terms();
+    dense[1 << 20] = 5;
+    assert ( dense.sparse() && dense.degree() == 1 << 20 && dense[98] == 2.0 );
+    terms.emplace_back(1 << 20, 5.0);
+    assert ( dense.terms() == terms );
+    dense[1 << 20] = 0;
+    dense *= CPolynomial(dense);
+    assert ( !dense.sparse() && dense.degree() == 196 );
+}
+
+void testExpressions(){
+    CPolynomial a, b, c, eager;
+    a[0] = 1;
+    a[3] = -2;
+    b[1] = 0.5;
+    b[2] = 4;
+    eager = a;
+    eager *= 2;
+    eager *= b;
+    eager *= 3;
+
+    // Scalars scale the temporaries in place and the product fits the inline storage
+    size_t before = allocationCount;
+    c = 2 * a * b * 3;
+    assert ( allocationCount == before && c == eager && CPolynomial::product(a, b, 6) == eager );
+    c = a * 2.5;
+    assert ( allocationCount == before && c[3] == -5.0 );
+
+    // A temporary operand lends its buffer
+    CPolynomial d(a);
+    before = allocationCount;
+    c = std::move(d) * 2;
+    c = 0.5 * std::move(c);
+    assert ( allocationCount == before && c == a );
+
+    // More factors, on either side
+    CPolynomial e = a * b * a, f = (2 * a) * (b * 3), g = b * (a * a);
+    eager = a;
+    eager *= b;
+    eager *= a;
+    assert ( e == eager && g == eager && f == 6 * a * b );
+    ostringstream out;
+    out << a * b;
+    assert ( out.str() == "- 8*x^5 - x^4 + 4*x^2 + 0.5*x^1" );
+
+    // A product is a polynomial of its own, later writes to its operands leave it alone
+    CPolynomial h;
+    for (size_t i = 0; i < 20; i++) {
+        h[i] = double(i % 3);
+    }
+    auto copyOf = [](const CPolynomial& p){ return p; };
+    eager = h;
+    eager *= b;
+    assert ( copyOf(h) * b == eager && b * copyOf(h) == eager && (2 * b) * copyOf(h) == 2 * eager );
+    assert ( (h * b).degree() == 21 && (h * 2)(1.0) == 38.0 && (h * b)[1] == 0.0 && !(h * CPolynomial()) );
+    auto scaled = h * 2;
+    auto product = h * b;
+    h[1] = 100;
+    assert ( scaled[1] == 2.0 && product == eager );
+    h[1] = 1;
+
+    // Moving leaves the zero polynomial behind, still fit for every operation
+    CPolynomial source(h), target(std::move(source));
+    vector<double> xs{1.0, 2.0}, values(2);
+    source.evaluate(xs, values);
+    assert ( !source && source.degree() == 0 && values == vector<double>({0.0, 0.0}) && target == h );
+    source *= b;
+    assert ( !source && !(source * b) );
+    source = std::move(target);
+    assert ( !target && source == h );
+
+    CPolynomial sparse;
+    sparse[100000] = 2;
+    sparse = -1.5 * sparse * sparse;
+    assert ( sparse.sparse() && sparse.terms() == (vector<CPolynomial::Term>{{200000, -6.0}}) );
+}
+
+void testInlineStorage(){
+    // Degree-3 values are built, copied, scaled and multiplied without a single allocation
+    size_t before = allocationCount;
+    CPolynomial a;
+    a[0] = 1;
+    a[3] = 2;
+    CPolynomial b(a), c = a * 3.0, d = a * b;
+    b = c;
+    assert ( allocationCount == before );
+    assert ( b[3] == 6.0 && d.degree() == 6 && d[6] == 4.0 && d[3] == 4.0 && d[0] == 1.0 );
+
+    // Past the inline capacity the values move to the heap and back
+    for (size_t i = 0; i < 20; i++) {
+        a[i] = double(i);
+    }
+    assert ( allocationCount > before && a.degree() == 19 && a[8] == 8.0 && a(1.0) == 190.0 );
+    CPolynomial e(a);
+    e *= 0;
+    e *= CPolynomial();
+    assert ( !e && e.degree() == 0 );
+    CPolynomial f = a * a;
+    assert ( f.degree() == 38 && f[38] == 361.0 && f[1] == 0.0 && f[2] == 1.0 );
+}
+
+// The typical degree-3 workload, allocations and time per iteration
+void benchmarkInlineStorage(){
+    const size_t rounds = 1'000'000;
+    volatile double sink = 0;
+    size_t before = allocationCount;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; i++) {
+        CPolynomial p;
+        p[0] = double(i);
+        p[1] = 0.5;
+        p[3] = -1;
+        CPolynomial q(p), r = 2 * p;
+        r *= q;
+        sink = sink + r(0.25);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "degree-3 workload: " << fixed << setprecision(1) << seconds / rounds * 1e9 << " ns and "
+         << double(allocationCount - before) / rounds << " allocations per iteration" << endl;
+}
+
+void testStatic(){
+    // A filter folded at compile time
+    constexpr CStaticPolynomial<2> p(1, 2.0, 3.0);
+    constexpr CStaticPolynomial<1> q(-1.0, 1.0);
+    constexpr auto filter = p * q * 2.0;
+    static_assert ( p(2.0) == 17.0 && p.degree() == 2 );
+    static_assert ( filter.degree() == 3 && filter[3] == 6.0 && filter[0] == -2.0 && filter(1.0) == 0.0 );
+    static_assert ( CStaticPolynomial<4>(0.0, 1.0) == CStaticPolynomial<1>(0.0, 1.0) && CStaticPolynomial<0>().degree() == 0 );
+    static_assert ( !is_convertible_v<double, CStaticPolynomial<3>> );
+
+    // Interoperability with CPolynomial
+    CPolynomial dynamic = p;
+    assert ( dynamic.degree() == 2 && dynamic[2] == 3.0 && dynamic(2.0) == p(2.0) );
+    CPolynomial product = dynamic * q;
+    assert ( CStaticPolynomial<3>(product) == p * q );
+    bool thrown = false;
+    try {
+        CStaticPolynomial<2> tooSmall(product);
+    } catch (const length_error &) {
+        thrown = true;
+    }
+    assert ( thrown );
+    CStaticPolynomial<2> written = p;
+    written[2] = 4.0;
+    thrown = false;
+    try {
+        written[3] = 1.0;
+    } catch (const out_of_range &) {
+        thrown = true;
+    }
+    assert ( thrown && written[2] == 4.0 && as_const(written)[3] == 0.0 );
+    ostringstream out;
+    out << CPolynomial(filter);
+    assert ( out.str() == "6*x^3 - 2*x^2 - 2*x^1 - 2" );
+}
+
+// A random divisor of degree m with a dominant leading coefficient, so that long quotients stay bounded
+CPolynomial randomDivisor(size_t m, mt19937 & rng){
+    CPolynomial res;
+    vector<double> coefficients = randomCoefficients(m + 1, rng, false);
+    for (size_t i = 0; i < m; i++) {
+        res[i] = coefficients[i] / double(m);
+    }
+    res[m] = 1.0;
+    return res;
+}
+
+void testDivision(){
+    CPolynomial a, b;
+    a[2] = 1;
+    a[0] = -1;
+    b[1] = 1;
+    b[0] = -1;
+    auto [q, r] = a.divmod(b);
+    ostringstream out;
+    out << q << " | " << r;
+    assert ( out.str() == "x^1 + 1 | 0" );
+    assert ( a / b == q && !(a % b) && b / a == CPolynomial() && b % a == b );
+    assert ( (a * 4.0) / (2 * b) == 2 * q );
+    bool thrown = false;
+    try {
+        a / CPolynomial();
+    } catch (const domain_error &) {
+        thrown = true;
+    }
+    assert ( thrown );
+    for (auto [dividend, divisor] : vector<pair<vector<double>, vector<double>>>{{{1}, {1, 1}}, {{1, 2}, {1, 0}}, {{1}, {}}}) {
+        thrown = false;
+        try {
+            CPolynomial::divide(dividend, divisor);
+        } catch (const invalid_argument &) {
+            thrown = true;
+        }
+        assert ( thrown );
+    }
+
+    // Both methods agree and dividend = divisor * quotient + remainder
+    mt19937 rng(23);
+    for (auto [n, m] : vector<pair<size_t, size_t>>{{5, 0}, {40, 3}, {300, 150}, {1000, 200}, {3000, 1400}}) {
+        CPolynomial dividend;
+        vector<double> coefficients = randomCoefficients(n + 1, rng, false);
+        for (size_t i = 0; i <= n; i++) {
+            dividend[i] = coefficients[i];
+        }
+        CPolynomial divisor = randomDivisor(m, rng);
+        for (auto method : {CPolynomial::EDivision::Schoolbook, CPolynomial::EDivision::Newton}) {
+            auto [quotient, remainder] = dividend.divmod(divisor, method);
+            assert ( quotient.degree() == n - m && (m == 0 ? !remainder : remainder.degree() < m) );
+            CPolynomial check = divisor * quotient;
+            for (size_t i = 0; i <= n; i++) {
+                assert ( abs(check[i] + remainder[i] - dividend[i]) <= 1e-9 );
+            }
+        }
+    }
+    CPolynomial sparse;
+    sparse[100000] = 1;
+    sparse[0] = -1;
+    CPolynomial ones = sparse / b;
+    assert ( ones.degree() == 99999 && ones[0] == 1.0 && ones[99999] == 1.0 && !(sparse % b) );
+
+    // A sparse dividend of huge degree reduces without its dense form, x^2 = -1 resp. x^2 = -1/2 modulo these
+    CPolynomial huge, unit, halved;
+    huge[1000000000] = 1;
+    unit[2] = 1;
+    unit[0] = 1;
+    halved[2] = 2;
+    halved[0] = 1;
+    CPolynomial remainder = huge % unit;
+    assert ( remainder.degree() == 0 && remainder[0] == 1.0 );
+    huge[1000000001] = 1;
+    huge[5] = 3;
+    remainder = huge % unit;
+    assert ( remainder.degree() == 1 && remainder[0] == 1.0 && remainder[1] == 4.0 );
+    assert ( huge % (unit * 5.0) == remainder );
+    remainder = huge % halved;
+    assert ( remainder.degree() == 1 && abs(remainder[0]) < 1e-300 && abs(remainder[1] - 0.75) < 1e-12 );
+    assert ( !(sparse % unit) && sparse % unit == sparse.divmod(unit).second );
+}
+
+void testMultipoint(){
+    using EMultipoint = CPolynomial::EMultipoint;
+    CPolynomial a;
+    a[2] = 1;
+    a[0] = -1;
+    vector<double> xs{-1, 0, 1, 2, 0.5}, out(xs.size());
+    for (auto method : {EMultipoint::Direct, EMultipoint::Tree}) {
+        a.evaluateMultipoint(xs, out, method);
+        assert ( out == vector<double>({0, -1, 0, 3, -0.75}) );
+        assert ( CPolynomial::interpolate(span(xs).first(3), span(out).first(3), method) == a );
+        assert ( CPolynomial::interpolate(xs, out, method) == a );
+    }
+    a.evaluateMultipoint({}, {});
+    assert ( !CPolynomial::interpolate({}, {}) );
+
+    // Both methods agree: interpolation where the points keep it well conditioned,
+    // evaluation through a deep tree while the degree stays low
+    mt19937 rng(24);
+    uniform_real_distribution<double> point(-1.0, 1.0);
+    for (size_t n : {1, 2, 8, 12}) {
+        vector<double> chebyshev(n), ys(n);
+        for (size_t i = 0; i < n; i++) {
+            chebyshev[i] = cos(M_PI * (i + 0.5) / n);
+            ys[i] = point(rng);
+        }
+        CPolynomial direct = CPolynomial::interpolate(chebyshev, ys, EMultipoint::Direct);
+        CPolynomial tree = CPolynomial::interpolate(chebyshev, ys, EMultipoint::Tree);
+        for (size_t i = 0; i < n; i++) {
+            assert ( abs(direct[i] - tree[i]) <= 1e-9 && abs(direct(chebyshev[i]) - ys[i]) <= 1e-9 );
+        }
+    }
+    for (size_t degree : {3, 16}) {
+        vector<double> coefficients = randomCoefficients(degree + 1, rng, false), points(5000), direct(5000), tree(5000);
+        CPolynomial p;
+        for (size_t i = 0; i <= degree; i++) {
+            p[i] = coefficients[i];
+        }
+        for (double & x : points) {
+            x = point(rng);
+        }
+        p.evaluateMultipoint(points, direct, EMultipoint::Direct);
+        p.evaluateMultipoint(points, tree, EMultipoint::Tree);
+        for (size_t i = 0; i < points.size(); i++) {
+            assert ( abs(direct[i] - tree[i]) <= 1e-12 * max(1.0, abs(direct[i])) );
+        }
+    }
+
+    // The default is Direct at any size, also past where speed alone would pick the tree
+    CPolynomial high;
+    high[200000] = 1;
+    high[1] = -1;
+    vector<double> points(200000), direct(points.size()), defaulted(points.size());
+    for (double & x : points) {
+        x = point(rng);
+    }
+    high.evaluateMultipoint(points, direct, EMultipoint::Direct);
+    high.evaluateMultipoint(points, defaulted);
+    assert ( defaulted == direct && abs(defaulted[0] + points[0]) <= 1e-12 );
+    vector<double> spread(3000), ones(spread.size(), 1.0);
+    for (size_t i = 0; i < spread.size(); i++) {
+        spread[i] = cos(M_PI * (i + 0.5) / spread.size());
+    }
+    CPolynomial one;
+    one[0] = 1;
+    assert ( CPolynomial::interpolate(spread, ones) == one );
+}
+
+// |p(z)| against the bound on its rounding error, the sum of |a_i z^i|
+double rootResidual(const vector<double>& coefficients, complex<double> z){
+    complex<double> value = 0.0;
+    double bound = 0.0;
+    for (size_t i = coefficients.size(); i-- > 0;) {
+        value = value * z + coefficients[i];
+        bound = bound * abs(z) + abs(coefficients[i]);
+    }
+    return abs(value) / bound;
+}
+
+void testRoots(){
+    CPolynomial a;
+    a[2] = 1;
+    a[0] = -1;
+    vector<complex<double>> r = a.roots();
+    sort(r.begin(), r.end(), [](auto x, auto y){ return x.real() < y.real(); });
+    assert ( r.size() == 2 && abs(r[0] + 1.0) <= 1e-12 && abs(r[1] - 1.0) <= 1e-12 );
+    a[0] = 1;
+    r = a.roots();
+    assert ( r.size() == 2 && abs(r[0] * r[1] - 1.0) <= 1e-12 && abs(r[0] * r[0] + 1.0) <= 1e-12 && abs(r[0] + r[1]) <= 1e-12 );
+
+    // x^2 (x - 1)(x - 2)...(x - 10), zero roots exact and the rest well within Wilkinson-style conditioning
+    CPolynomial w;
+    w[2] = 1;
+    for (int k = 1; k <= 10; k++) {
+        CPolynomial factor;
+        factor[1] = 1;
+        factor[0] = -k;
+        w = w * factor;
+    }
+    r = w.roots();
+    assert ( r.size() == 12 && r[0] == 0.0 && r[1] == 0.0 );
+    sort(r.begin() + 2, r.end(), [](auto x, auto y){ return x.real() < y.real(); });
+    for (int k = 1; k <= 10; k++) {
+        assert ( abs(r[k + 1] - double(k)) <= 1e-8 );
+    }
+    // Multiple roots stop at the rounding noise instead of running out of steps
+    for (int multiplicity = 2; multiplicity <= 6; multiplicity++) {
+        CPolynomial m, factor;
+        m[0] = 1;
+        factor[1] = 1;
+        factor[0] = -1;
+        for (int k = 0; k < multiplicity; k++) {
+            m = m * factor;
+        }
+        for (size_t threads : {1, 4}) {
+            r = m.roots(1e-12, threads);
+            assert ( r.size() == size_t(multiplicity) );
+            for (auto z : r) {
+                assert ( abs(z - 1.0) <= 1e-2 );
+            }
+        }
+    }
+    CPolynomial broken;
+    broken[3] = 1;
+    broken[1] = NAN;
+    broken[0] = 1;
+    bool thrown = false;
+    try {
+        broken.roots(1e-12, 2);
+    } catch (const runtime_error &) {
+        thrown = true;
+    }
+    assert ( thrown );
+    CPolynomial constant;
+    constant[0] = 5;
+    assert ( constant.roots().empty() );
+    thrown = false;
+    try {
+        CPolynomial().roots();
+    } catch (const domain_error &) {
+        thrown = true;
+    }
+    assert ( thrown );
+
+    // Random polynomials: every root a root up to rounding, threads split the work without changing it
+    mt19937 rng(25);
+    for (size_t degree : {7, 100, 1000}) {
+        vector<double> coefficients = randomCoefficients(degree + 1, rng, false);
+        CPolynomial p;
+        for (size_t i = 0; i <= degree; i++) {
+            p[i] = coefficients[i];
+        }
+        r = p.roots();
+        assert ( r.size() == degree && r == p.roots(1e-12, 4) );
+        for (auto z : r) {
+            assert ( rootResidual(coefficients, z) <= 1e-12 );
+        }
+    }
+}
+
+// A million points per degree, one operator() call per point against evaluate with each scheme
+void benchmarkEvaluate(){
+    using EScheme = CPolynomial::EScheme;
+    mt19937 rng(18);
+    vector<double> xs(1'000'000), out(xs.size());
+    uniform_real_distribution<double> point(-1.0, 1.0);
+    for (double & x : xs) {
+        x = point(rng);
+    }
+    auto measure = [&](auto && pass){
+        auto start = chrono::steady_clock::now();
+        pass();
+        return xs.size() / chrono::duration<double>(chrono::steady_clock::now() - start).count() / 1e6;
+    };
+    cout << setw(9) << "degree";
+    for (const char * name : {"operator()", "horner", "estrin", "auto, all"}) {
+        cout << setw(14) << name;
+    }
+    cout << "  (M points/s)" << endl << fixed << setprecision(1);
+    size_t cores = max(1u, thread::hardware_concurrency());
+    for (size_t degree : {3, 7, 15, 23, 31, 63, 255, 1023}) {
+        CPolynomial p;
+        vector<double> coefficients = randomCoefficients(degree + 1, rng, false);
+        for (size_t i = 0; i <= degree; i++) {
+            p[i] = coefficients[i];
+        }
+        cout << setw(9) << degree
+             << setw(14) << measure([&]{ for (size_t i = 0; i < xs.size(); i++) out[i] = p(xs[i]); })
+             << setw(14) << measure([&]{ p.evaluate(xs, out, 1, EScheme::Horner); })
+             << setw(14) << measure([&]{ p.evaluate(xs, out, 1, EScheme::Estrin); })
+             << setw(14) << measure([&]{ p.evaluate(xs, out, cores); }) << endl;
+    }
+}
+
+// Squares of polynomials with few terms at exponents up to 10^9, which dense storage could not even hold
+void benchmarkSparse(){
+    mt19937_64 rng(19);
+    for (size_t count : {10, 100, 1000}) {
+        CPolynomial p;
+        for (size_t i = 0; i < count; i++) {
+            p[rng() % 1'000'000'000] = 1.0;
+        }
+        auto start = chrono::steady_clock::now();
+        CPolynomial square = p * p;
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << setw(6) << count << " terms up to x^10^9: square of " << square.terms().size() << " terms in "
+             << fixed << setprecision(1) << seconds * 1e3 << " ms" << endl;
+    }
+}
+
+// A degree-5 filter evaluated at ten million points, as CStaticPolynomial and as CPolynomial
+void benchmarkStatic(){
+    constexpr CStaticPolynomial<5> filter = CStaticPolynomial<2>(0.5, -0.25, 0.125) * CStaticPolynomial<3>(1.0, 0.5, 0.25, 0.125);
+    CPolynomial dynamic = filter;
+    const size_t points = 10'000'000;
+    auto measure = [points](auto && p){
+        volatile double sink = 0;
+        double x = 0, sum = 0;
+        auto start = chrono::steady_clock::now();
+        for (size_t i = 0; i < points; i++) {
+            sum += p(x);
+            x += 1e-7;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        sink = sink + sum;
+        return seconds / points * 1e9;
+    };
+    cout << "degree-5 filter: CStaticPolynomial " << fixed << setprecision(2) << measure(filter)
+         << " ns, CPolynomial " << measure(dynamic) << " ns per point" << endl;
+}
+
+// Division of a degree-2m polynomial by a degree-m one, long division against the Newton reciprocal
+void benchmarkDivision(){
+    using EDivision = CPolynomial::EDivision;
+    mt19937 rng(23);
+    cout << setw(9) << "divisor" << setw(14) << "schoolbook" << setw(14) << "newton" << endl << fixed << setprecision(1);
+    for (size_t m : {64, 256, 1024, 1536, 2048, 4096, 16384, 65536}) {
+        CPolynomial dividend = randomDivisor(2 * m, rng), divisor = randomDivisor(m, rng);
+        cout << setw(9) << m;
+        for (EDivision method : {EDivision::Schoolbook, EDivision::Newton}) {
+            auto start = chrono::steady_clock::now();
+            size_t rounds = 0;
+            do {
+                dividend.divmod(divisor, method);
+                rounds++;
+            } while (chrono::steady_clock::now() - start < chrono::milliseconds(200));
+            cout << setw(12) << chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds * 1e6 << "us";
+        }
+        cout << endl;
+    }
+}
+
+// A degree n - 1 polynomial at n points and back by interpolation, direct against the subproduct tree
+void benchmarkMultipoint(){
+    using EMultipoint = CPolynomial::EMultipoint;
+    mt19937 rng(24);
+    uniform_real_distribution<double> point(-1.0, 1.0);
+    auto measure = [](auto && pass){
+        auto start = chrono::steady_clock::now();
+        size_t rounds = 0;
+        do {
+            pass();
+            rounds++;
+        } while (chrono::steady_clock::now() - start < chrono::milliseconds(200));
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count() / rounds * 1e3;
+    };
+    cout << setw(9) << "points";
+    for (const char * name : {"eval direct", "eval tree", "interp direct", "interp tree"}) {
+        cout << setw(16) << name;
+    }
+    cout << "  (ms)" << endl << fixed << setprecision(2);
+    for (size_t n : {256, 1024, 2048, 4096, 16384, 65536, 131072, 262144}) {
+        vector<double> xs(n), ys(n), coefficients = randomCoefficients(n, rng, false);
+        for (double & x : xs) {
+            x = point(rng);
+        }
+        CPolynomial p;
+        for (size_t i = 0; i < n; i++) {
+            p[i] = coefficients[i];
+        }
+        cout << setw(9) << n;
+        for (EMultipoint method : {EMultipoint::Direct, EMultipoint::Tree}) {
+            cout << setw(16) << measure([&]{ p.evaluateMultipoint(xs, ys, method); });
+        }
+        for (EMultipoint method : {EMultipoint::Direct, EMultipoint::Tree}) {
+            if (n > 16384) break;
+            cout << setw(16) << measure([&]{ CPolynomial::interpolate(xs, ys, method); });
+        }
+        cout << endl;
+    }
+}
+
+// All roots of random polynomials, on one thread and on every core
+void benchmarkRoots(){
+    mt19937 rng(25);
+    size_t cores = max(1u, thread::hardware_concurrency());
+    cout << setw(9) << "degree" << setw(14) << "1 thread" << setw(10) << cores << " threads  (ms)" << endl << fixed << setprecision(1);
+    for (size_t degree : {100, 500, 1000, 2000, 4000}) {
+        vector<double> coefficients = randomCoefficients(degree + 1, rng, false);
+        CPolynomial p;
+        for (size_t i = 0; i <= degree; i++) {
+            p[i] = coefficients[i];
+        }
+        cout << setw(9) << degree;
+        for (size_t threads : {size_t(1), cores}) {
+            auto start = chrono::steady_clock::now();
+            p.roots(1e-12, threads);
+            cout << setw(14) << chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1e3;
+        }
+        cout << endl;
+    }
+}
+
+int main (int argc, char * argv[])
 {
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        benchmarkMultiply();
+        benchmarkEvaluate();
+        benchmarkSparse();
+        benchmarkInlineStorage();
+        benchmarkStatic();
+        benchmarkDivision();
+        benchmarkMultipoint();
+        benchmarkRoots();
+        return EXIT_SUCCESS;
+    }
+    testMultiply();
+    testEvaluate();
+    testSparse();
+    testExpressions();
+    testInlineStorage();
+    testStatic();
+    testDivision();
+    testMultipoint();
+    testRoots();
+
     CPolynomial a, b, c;
     std::ostringstream out, tmp;
 
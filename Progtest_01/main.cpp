@@ -4,164 +4,3966 @@
 #include <cmath>
 #include <cassert>
 #include <cstring>
+#include <cstdint>
+#include <climits>
 #include <iostream>
 #include <iomanip>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
+#include <array>
+#include <span>
+#include <set>
+#include <queue>
+#include <map>
 #include <memory>
 #include <compare>
 #include <functional>
 #include <stdexcept>
 #include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <tuple>
+#include <bit>
+#include <charconv>
+#include <unordered_map>
+#include <malloc.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 #endif /* __PROGTEST__ */
 
 using namespace std;
 
-struct Citizen{
-    string name;
-    string address;
-    string account;
-    int income = 0;
-    int expenses = 0;
-    Citizen(const string & name,const string & address, const string & account):
-            name(name), address(address), account(account){};
-    bool operator<(const Citizen & other){
-        return tie(name,address) <tie(other.name,other.address);
+//Ordered index with wide nodes kept in contiguous arenas, nodes are addressed by 32-bit ids.
+//Leaves are linked left to right, so an in-order scan never goes back to the inner nodes.
+//Keys must be unique with respect to Cmp, uniqueness is up to the caller.
+template <typename T, typename Cmp, size_t Fanout = 64>
+class CBPlusTree
+{
+    static_assert(Fanout >= 4, "Fanout too small");
+    static constexpr uint32_t NIL = UINT32_MAX;
+    static constexpr size_t MIN_FILL = Fanout / 2;
+    static constexpr size_t MAX_DEPTH = 16;
+
+    struct Leaf{
+        uint32_t count = 0;
+        uint32_t next = NIL;
+        T items[Fanout];
+    };
+    struct Inner{
+        uint32_t count = 0;              //number of children, separators = count - 1
+        T keys[Fanout - 1];              //keys[i] is the smallest item of children[i + 1]
+        uint32_t children[Fanout];
+    };
+public:
+    class CCursor{
+    public:
+        CCursor() = default;
+        bool atEnd() const { return leaf == NIL; }
+        const T & operator*() const { return tree->leaves[leaf].items[pos]; }
+        const T * operator->() const { return &**this; }
+        CCursor & operator++(){
+            ++pos;
+            skipExhausted();
+            return *this;
+        }
+    private:
+        friend class CBPlusTree;
+        CCursor(const CBPlusTree * tree, uint32_t leaf, uint32_t pos) : tree(tree), leaf(leaf), pos(pos){
+            skipExhausted();
+        }
+        void skipExhausted(){
+            while(leaf != NIL && pos >= tree->leaves[leaf].count){
+                leaf = tree->leaves[leaf].next;
+                pos = 0;
+            }
+        }
+        const CBPlusTree * tree = nullptr;
+        uint32_t leaf = NIL;
+        uint32_t pos = 0;
+    };
+
+    explicit CBPlusTree(Cmp cmp = Cmp()) : cmp(cmp){
+        clear();
+    }
+
+    void clear(){
+        leaves.clear();
+        inners.clear();
+        freeLeaves.clear();
+        freeInners.clear();
+        root = head = allocLeaf();
+        height = 0;
+        itemCount = 0;
+        modificationCount++;
+    }
+
+    size_t size() const { return itemCount; }
+    bool empty() const { return itemCount == 0; }
+
+    //Bumped by every change, cursors taken before a change must not be used after it
+    uint64_t modifications() const { return modificationCount; }
+
+    CCursor begin() const {
+        return CCursor(this, head, 0);
+    }
+
+    //Replaces the contents with already sorted unique items, packing the nodes bottom-up
+    void assign(vector<T> && sorted){
+        clear();
+        if(sorted.empty()) return;
+        itemCount = sorted.size();
+
+        //Spread items evenly, so every node except a lone root stays at least half full
+        size_t leafCount = (sorted.size() + Fanout - 1) / Fanout;
+        vector<uint32_t> level(leafCount);
+        vector<T> mins(leafCount);
+        leaves.reserve(leafCount);
+        for(size_t i = 0, from = 0; i < leafCount; i++){
+            size_t to = sorted.size() * (i + 1) / leafCount;
+            uint32_t id = i == 0 ? head : allocLeaf();
+            Leaf & lf = leaves[id];
+            move(sorted.begin() + from, sorted.begin() + to, lf.items);
+            lf.count = to - from;
+            if(i > 0) leaves[level[i - 1]].next = id;
+            level[i] = id;
+            mins[i] = lf.items[0];
+            from = to;
+        }
+
+        while(level.size() > 1){
+            size_t nodeCount = (level.size() + Fanout - 1) / Fanout;
+            vector<uint32_t> parents(nodeCount);
+            vector<T> parentMins(nodeCount);
+            for(size_t i = 0, from = 0; i < nodeCount; i++){
+                size_t to = level.size() * (i + 1) / nodeCount;
+                uint32_t id = allocInner();
+                Inner & in = inners[id];
+                copy(level.begin() + from, level.begin() + to, in.children);
+                move(mins.begin() + from + 1, mins.begin() + to, in.keys);
+                in.count = to - from;
+                parents[i] = id;
+                parentMins[i] = std::move(mins[from]);
+                from = to;
+            }
+            level.swap(parents);
+            mins.swap(parentMins);
+            height++;
+        }
+        root = level[0];
+    }
+
+    //First item that is not less than key
+    template <typename K>
+    CCursor lowerBound(const K & key) const {
+        uint32_t node = root;
+        for(uint32_t level = 0; level < height; level++){
+            const Inner & in = inners[node];
+            node = in.children[upperSlot(in, key)];
+        }
+        const Leaf & lf = leaves[node];
+        auto pos = lower_bound(lf.items, lf.items + lf.count, key, cmp) - lf.items;
+        return CCursor(this, node, pos);
+    }
+
+    void insert(T value){
+        array<pair<uint32_t, uint32_t>, MAX_DEPTH> path;
+        uint32_t node = descend(value, path);
+
+        Leaf * lf = &leaves[node];
+        uint32_t pos = upper_bound(lf->items, lf->items + lf->count, value, cmp) - lf->items;
+        itemCount++;
+        modificationCount++;
+        if(lf->count < Fanout){
+            insertAt(lf->items, lf->count, pos, std::move(value));
+            lf->count++;
+            return;
+        }
+
+        //Split the full leaf in halves, then place the new item
+        uint32_t rightId = allocLeaf();
+        lf = &leaves[node];
+        Leaf & right = leaves[rightId];
+        uint32_t keep = Fanout / 2;
+        move(lf->items + keep, lf->items + Fanout, right.items);
+        right.count = Fanout - keep;
+        lf->count = keep;
+        right.next = lf->next;
+        lf->next = rightId;
+        if(pos <= keep){
+            insertAt(lf->items, lf->count, pos, std::move(value));
+            lf->count++;
+        } else {
+            insertAt(right.items, right.count, pos - keep, std::move(value));
+            right.count++;
+        }
+        insertIntoParents(path, right.items[0], rightId);
+    }
+
+    //Removes the item equal to key, returns false if there is none
+    template <typename K>
+    bool erase(const K & key){
+        array<pair<uint32_t, uint32_t>, MAX_DEPTH> path;
+        uint32_t node = descend(key, path);
+
+        Leaf & lf = leaves[node];
+        uint32_t pos = lower_bound(lf.items, lf.items + lf.count, key, cmp) - lf.items;
+        if(pos == lf.count || cmp(key, lf.items[pos])) return false;
+
+        move(lf.items + pos + 1, lf.items + lf.count, lf.items + pos);
+        lf.items[--lf.count] = T();
+        itemCount--;
+        modificationCount++;
+        if(height == 0) return true;
+
+        //Separators always hold live items, replace the one that pointed at the erased minimum
+        if(pos == 0){
+            for(uint32_t level = height; level-- > 0;){
+                auto [parent, slot] = path[level];
+                if(slot > 0){
+                    inners[parent].keys[slot - 1] = lf.items[0];
+                    break;
+                }
+            }
+        }
+        if(lf.count < MIN_FILL) rebalanceLeaf(node, path);
+        return true;
+    }
+
+private:
+    template <typename K>
+    uint32_t upperSlot(const Inner & in, const K & key) const {
+        return upper_bound(in.keys, in.keys + in.count - 1, key, cmp) - in.keys;
+    }
+
+    template <typename K>
+    uint32_t descend(const K & key, array<pair<uint32_t, uint32_t>, MAX_DEPTH> & path) const {
+        uint32_t node = root;
+        for(uint32_t level = 0; level < height; level++){
+            const Inner & in = inners[node];
+            uint32_t slot = upperSlot(in, key);
+            path[level] = {node, slot};
+            node = in.children[slot];
+        }
+        return node;
+    }
+
+    static void insertAt(T * items, uint32_t count, uint32_t pos, T && value){
+        move_backward(items + pos, items + count, items + count + 1);
+        items[pos] = std::move(value);
+    }
+
+    void insertIntoParents(array<pair<uint32_t, uint32_t>, MAX_DEPTH> & path, T separator, uint32_t child){
+        for(uint32_t level = height; level-- > 0;){
+            auto [parentId, slot] = path[level];
+            Inner * in = &inners[parentId];
+            if(in->count < Fanout){
+                insertAt(in->keys, in->count - 1, slot, std::move(separator));
+                move_backward(in->children + slot + 1, in->children + in->count, in->children + in->count + 1);
+                in->children[slot + 1] = child;
+                in->count++;
+                return;
+            }
+
+            //Full inner node, split it around the middle separator
+            T keys[Fanout];
+            uint32_t children[Fanout + 1];
+            move(in->keys, in->keys + slot, keys);
+            keys[slot] = std::move(separator);
+            move(in->keys + slot, in->keys + Fanout - 1, keys + slot + 1);
+            copy(in->children, in->children + slot + 1, children);
+            children[slot + 1] = child;
+            copy(in->children + slot + 1, in->children + Fanout, children + slot + 2);
+
+            uint32_t rightId = allocInner();
+            in = &inners[parentId];
+            Inner & right = inners[rightId];
+            uint32_t leftCount = (Fanout + 1) / 2;
+            move(keys, keys + leftCount - 1, in->keys);
+            copy(children, children + leftCount, in->children);
+            in->count = leftCount;
+            move(keys + leftCount, keys + Fanout, right.keys);
+            copy(children + leftCount, children + Fanout + 1, right.children);
+            right.count = Fanout + 1 - leftCount;
+            separator = std::move(keys[leftCount - 1]);
+            child = rightId;
+        }
+
+        uint32_t newRoot = allocInner();
+        Inner & in = inners[newRoot];
+        in.count = 2;
+        in.keys[0] = std::move(separator);
+        in.children[0] = root;
+        in.children[1] = child;
+        root = newRoot;
+        height++;
+    }
+
+    void rebalanceLeaf(uint32_t node, array<pair<uint32_t, uint32_t>, MAX_DEPTH> & path){
+        auto [parentId, slot] = path[height - 1];
+        Inner & parent = inners[parentId];
+        Leaf & lf = leaves[node];
+
+        if(slot > 0){
+            Leaf & left = leaves[parent.children[slot - 1]];
+            if(left.count > MIN_FILL){
+                insertAt(lf.items, lf.count, 0, std::move(left.items[--left.count]));
+                lf.count++;
+                parent.keys[slot - 1] = lf.items[0];
+                return;
+            }
+        }
+        if(slot + 1 < parent.count){
+            Leaf & right = leaves[parent.children[slot + 1]];
+            if(right.count > MIN_FILL){
+                lf.items[lf.count++] = std::move(right.items[0]);
+                move(right.items + 1, right.items + right.count, right.items);
+                right.items[--right.count] = T();
+                parent.keys[slot] = right.items[0];
+                return;
+            }
+        }
+
+        //Both neighbours are at minimum, merge the right one of the pair into the left one
+        uint32_t removeSlot = slot > 0 ? slot : slot + 1;
+        Leaf & left = leaves[parent.children[removeSlot - 1]];
+        uint32_t rightId = parent.children[removeSlot];
+        Leaf & right = leaves[rightId];
+        move(right.items, right.items + right.count, left.items + left.count);
+        left.count += right.count;
+        left.next = right.next;
+        releaseLeaf(rightId);
+        removeChild(parent, removeSlot);
+        rebalanceInner(height - 1, path);
+    }
+
+    void rebalanceInner(uint32_t level, array<pair<uint32_t, uint32_t>, MAX_DEPTH> & path){
+        for(; level > 0; level--){
+            uint32_t node = path[level].first;
+            Inner & in = inners[node];
+            if(in.count >= MIN_FILL) return;
+
+            auto [parentId, slot] = path[level - 1];
+            Inner & parent = inners[parentId];
+            if(slot > 0){
+                Inner & left = inners[parent.children[slot - 1]];
+                if(left.count > MIN_FILL){
+                    insertAt(in.keys, in.count - 1, 0, std::move(parent.keys[slot - 1]));
+                    move_backward(in.children, in.children + in.count, in.children + in.count + 1);
+                    in.children[0] = left.children[left.count - 1];
+                    in.count++;
+                    parent.keys[slot - 1] = std::move(left.keys[left.count - 2]);
+                    left.count--;
+                    return;
+                }
+            }
+            if(slot + 1 < parent.count){
+                Inner & right = inners[parent.children[slot + 1]];
+                if(right.count > MIN_FILL){
+                    in.keys[in.count - 1] = std::move(parent.keys[slot]);
+                    in.children[in.count] = right.children[0];
+                    in.count++;
+                    parent.keys[slot] = std::move(right.keys[0]);
+                    move(right.keys + 1, right.keys + right.count - 1, right.keys);
+                    right.keys[right.count - 2] = T();
+                    copy(right.children + 1, right.children + right.count, right.children);
+                    right.count--;
+                    return;
+                }
+            }
+
+            uint32_t removeSlot = slot > 0 ? slot : slot + 1;
+            Inner & left = inners[parent.children[removeSlot - 1]];
+            uint32_t rightId = parent.children[removeSlot];
+            Inner & right = inners[rightId];
+            left.keys[left.count - 1] = std::move(parent.keys[removeSlot - 1]);
+            move(right.keys, right.keys + right.count - 1, left.keys + left.count);
+            copy(right.children, right.children + right.count, left.children + left.count);
+            left.count += right.count;
+            releaseInner(rightId);
+            removeChild(parent, removeSlot);
+        }
+
+        if(height > 0 && inners[root].count == 1){
+            uint32_t oldRoot = root;
+            root = inners[root].children[0];
+            releaseInner(oldRoot);
+            height--;
+        }
+    }
+
+    static void removeChild(Inner & in, uint32_t slot){
+        move(in.keys + slot, in.keys + in.count - 1, in.keys + slot - 1);
+        in.keys[in.count - 2] = T();
+        copy(in.children + slot + 1, in.children + in.count, in.children + slot);
+        in.count--;
+    }
+
+    uint32_t allocLeaf(){
+        if(!freeLeaves.empty()){
+            uint32_t id = freeLeaves.back();
+            freeLeaves.pop_back();
+            return id;
+        }
+        leaves.emplace_back();
+        //Reserve the free list up front, so erase never allocates
+        freeLeaves.reserve(leaves.capacity());
+        return leaves.size() - 1;
+    }
+    uint32_t allocInner(){
+        if(!freeInners.empty()){
+            uint32_t id = freeInners.back();
+            freeInners.pop_back();
+            return id;
+        }
+        inners.emplace_back();
+        freeInners.reserve(inners.capacity());
+        return inners.size() - 1;
+    }
+    void releaseLeaf(uint32_t id){
+        Leaf & lf = leaves[id];
+        fill(lf.items, lf.items + lf.count, T());
+        lf.count = 0;
+        lf.next = NIL;
+        freeLeaves.push_back(id);
+    }
+    void releaseInner(uint32_t id){
+        Inner & in = inners[id];
+        fill(in.keys, in.keys + Fanout - 1, T());
+        in.count = 0;
+        freeInners.push_back(id);
+    }
+
+    vector<Leaf> leaves;
+    vector<Inner> inners;
+    vector<uint32_t> freeLeaves;
+    vector<uint32_t> freeInners;
+    uint32_t root = NIL;
+    uint32_t head = NIL;
+    uint32_t height = 0;
+    size_t itemCount = 0;
+    uint64_t modificationCount = 0;
+    [[no_unique_address]] Cmp cmp;
+};
+
+//Unordered index from a string key to a small value, open addressing with linear probing.
+//Each slot keeps the full hash next to the value, so a probe touches the value only on a hash match.
+//Erase shifts the rest of the probe run back instead of leaving tombstones.
+template <typename V, typename KeyOf>
+class CHashIndex
+{
+    struct Slot{
+        uint32_t hash = 0;               //0 marks an empty slot
+        V value{};
+    };
+public:
+    explicit CHashIndex(KeyOf keyOf = KeyOf()) : keyOf(keyOf){
+        clear();
+    }
+
+    void clear(){
+        slots.assign(16, Slot());
+        mask = slots.size() - 1;
+        itemCount = 0;
+    }
+
+    size_t size() const { return itemCount; }
+
+    void reserve(size_t count){
+        size_t capacity = slots.size();
+        while(count * 2 > capacity) capacity *= 2;
+        if(capacity != slots.size()) rehash(capacity);
+    }
+
+    const V * find(string_view key) const {
+        return find(key, hashOf(key));
+    }
+
+    //Lookup with a hash the caller already computed by hashOf
+    const V * find(string_view key, uint32_t h) const {
+        for(size_t i = h & mask;; i = (i + 1) & mask){
+            const Slot & slot = slots[i];
+            if(slot.hash == 0) return nullptr;
+            if(slot.hash == h && keyOf(slot.value) == key) return &slot.value;
+        }
+    }
+
+    //Returns false if the key of value is already present
+    bool insert(V value){
+        if((itemCount + 1) * 2 > slots.size()) rehash(slots.size() * 2);
+        uint32_t h = hashOf(keyOf(value));
+        size_t i = h & mask;
+        for(; slots[i].hash != 0; i = (i + 1) & mask){
+            if(slots[i].hash == h && keyOf(slots[i].value) == keyOf(value)) return false;
+        }
+        slots[i] = Slot{h, value};
+        itemCount++;
+        return true;
+    }
+
+    bool erase(string_view key){
+        uint32_t h = hashOf(key);
+        size_t hole = h & mask;
+        for(;; hole = (hole + 1) & mask){
+            if(slots[hole].hash == 0) return false;
+            if(slots[hole].hash == h && keyOf(slots[hole].value) == key) break;
+        }
+        for(size_t next = (hole + 1) & mask; slots[next].hash != 0; next = (next + 1) & mask){
+            size_t home = slots[next].hash & mask;
+            //Move the entry back unless its home lies cyclically in (hole, next]
+            bool stays = hole <= next ? (home > hole && home <= next) : (home > hole || home <= next);
+            if(!stays){
+                slots[hole] = slots[next];
+                hole = next;
+            }
+        }
+        slots[hole] = Slot();
+        itemCount--;
+        return true;
+    }
+
+    //32 bits keep the slots small, the full key comparison settles collisions
+    static uint32_t hashOf(string_view key){
+        uint64_t full = hash<string_view>{}(key);
+        uint32_t h = full ^ (full >> 32);
+        return h ? h : 1;
+    }
+
+    //Slot where the probe for hash h starts
+    size_t homeSlot(uint32_t h) const {
+        return h & mask;
+    }
+
+private:
+    void rehash(size_t capacity){
+        vector<Slot> old(capacity);
+        old.swap(slots);
+        mask = capacity - 1;
+        for(const Slot & slot : old){
+            if(slot.hash == 0) continue;
+            size_t i = slot.hash & mask;
+            while(slots[i].hash != 0) i = (i + 1) & mask;
+            slots[i] = slot;
+        }
+    }
+
+    vector<Slot> slots;
+    size_t mask = 0;
+    size_t itemCount = 0;
+    [[no_unique_address]] KeyOf keyOf;
+};
+
+//Growable array whose elements never move. Chunks double in size and the chunk table has a fixed size,
+//so other threads may keep reading existing elements while one thread appends.
+template <typename T>
+class CStableColumn
+{
+    static constexpr size_t FIRST_CHUNK = 64;
+    static constexpr size_t MAX_CHUNKS = 27;         //64 * (2^27 - 1) elements, more than 32-bit handles reach
+public:
+    CStableColumn() = default;
+    CStableColumn(const CStableColumn &) = delete;
+    CStableColumn & operator=(const CStableColumn &) = delete;
+
+    size_t size() const { return count; }
+
+    T & operator[](size_t i){
+        auto [chunk, offset] = locate(i);
+        return chunks[chunk][offset];
+    }
+    const T & operator[](size_t i) const {
+        auto [chunk, offset] = locate(i);
+        return chunks[chunk][offset];
+    }
+
+    void push_back(const T & value){
+        auto [chunk, offset] = locate(count);
+        if(!chunks[chunk]) chunks[chunk] = make_unique<T[]>(FIRST_CHUNK << chunk);
+        chunks[chunk][offset] = value;
+        count++;
+    }
+
+private:
+    static pair<size_t, size_t> locate(size_t i){
+        size_t chunk = bit_width(i / FIRST_CHUNK + 1) - 1;
+        return {chunk, i - FIRST_CHUNK * ((size_t(1) << chunk) - 1)};
+    }
+
+    array<unique_ptr<T[]>, MAX_CHUNKS> chunks;
+    size_t count = 0;
+};
+
+//String storage addressed by 32-bit ids, the bytes of a string never move while it is held.
+//Interned strings are stored once and shared by every id holder, each holder releases its id once.
+//A released string's id and bytes are reused together by a later string of the same size class,
+//so the pool grows with the strings held at once rather than with every string ever added.
+class CStringPool
+{
+    struct KeyOf{
+        const CStringPool * pool;
+        string_view operator()(uint32_t id) const {
+            return pool->get(id);
+        }
+    };
+public:
+    CStringPool() : interned(KeyOf{this}){
+        freeIds.fill(NONE);
+    }
+    CStringPool(const CStringPool &) = delete;
+    CStringPool & operator=(const CStringPool &) = delete;
+
+    string_view get(uint32_t id) const {
+        const char * data = starts[id];
+        uint32_t length;
+        memcpy(&length, data, sizeof(length));
+        return {data + sizeof(length), length};
+    }
+
+    //Stores a copy of str, strings are kept with a length prefix in large blocks
+    uint32_t add(string_view str){
+        if(str.size() > UINT32_MAX - sizeof(uint32_t)) throw length_error("String too long for the pool");
+        size_t sizeClass = classOf(sizeof(uint32_t) + str.size());
+        uint32_t id = freeIds[sizeClass];
+        if(id != NONE){
+            //A free slot keeps the id of the next free one of its class where the length goes
+            memcpy(&freeIds[sizeClass], starts[id], sizeof(id));
+            refs[id] = 1;
+        } else {
+            if(starts.size() >= NONE) throw length_error("String pool ran out of ids");
+            size_t need = slotSize(sizeClass);
+            if(blockFree < need){
+                blockFree = max(BLOCK_SIZE, need);
+                blocks.emplace_back(new char[blockFree]);
+                blockPos = blocks.back().get();
+            }
+            id = starts.size();
+            starts.push_back(blockPos);
+            refs.push_back(1);
+            blockPos += need;
+            blockFree -= need;
+        }
+        uint32_t length = str.size();
+        char * data = const_cast<char *>(starts[id]);
+        memcpy(data, &length, sizeof(length));
+        memcpy(data + sizeof(length), str.data(), str.size());
+        return id;
+    }
+
+    uint32_t intern(string_view str){
+        if(const uint32_t * id = interned.find(str)){
+            refs[*id]++;
+            return *id;
+        }
+        uint32_t id = add(str);
+        interned.insert(id);
+        return id;
+    }
+
+    //Drops one holder of id, the last one frees it. Never allocates.
+    void release(uint32_t id){
+        if(--refs[id] > 0) return;
+        string_view str = get(id);
+        if(const uint32_t * shared = interned.find(str); shared && *shared == id) interned.erase(str);
+        size_t sizeClass = classOf(sizeof(uint32_t) + str.size());
+        memcpy(const_cast<char *>(starts[id]), &freeIds[sizeClass], sizeof(id));
+        freeIds[sizeClass] = id;
+    }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 256 * 1024;
+    static constexpr uint32_t NONE = UINT32_MAX;
+    //Slots are multiples of 8 bytes up to SMALL_SLOT, powers of two beyond
+    static constexpr size_t SMALL_SLOT = 256;
+    static constexpr size_t SIZE_CLASSES = SMALL_SLOT / 8 + 32;
+
+    static size_t classOf(size_t need){
+        if(need <= SMALL_SLOT) return (need + 7) / 8 - 1;
+        return SMALL_SLOT / 8 + bit_width(need - 1) - bit_width(SMALL_SLOT);
+    }
+    static size_t slotSize(size_t sizeClass){
+        if(sizeClass < SMALL_SLOT / 8) return (sizeClass + 1) * 8;
+        return SMALL_SLOT << (sizeClass - SMALL_SLOT / 8 + 1);
+    }
+
+    CStableColumn<const char *> starts;
+    CStableColumn<uint32_t> refs;
+    array<uint32_t, SIZE_CLASSES> freeIds;
+    vector<unique_ptr<char[]>> blocks;
+    char * blockPos = nullptr;
+    size_t blockFree = 0;
+    CHashIndex<uint32_t, KeyOf> interned;
+};
+
+//Non-owning lookup key, lets the indexes be probed without building a citizen
+struct NameKey{
+    string_view name;
+    string_view address;
+    auto operator<=>(const NameKey & other) const = default;
+};
+
+//Several versions of one name may coexist while snapshots need the dead ones, the birth epoch orders them
+struct VersionKey{
+    NameKey key;
+    uint64_t bornEpoch;
+    auto operator<=>(const VersionKey & other) const = default;
+};
+
+//All citizens of a register as rows of parallel columns, addressed by 32-bit handles.
+//Names and addresses are interned, so people sharing them share the bytes.
+//add/release may run on several threads at once, reading rows that exist needs no lock.
+class CCitizenStore
+{
+public:
+    using Handle = uint32_t;
+    static constexpr Handle NONE = UINT32_MAX;
+    //Register epochs of the birth and death, snapshots see the citizen only between the two
+    static constexpr uint64_t ALIVE = UINT64_MAX;
+
+    CCitizenStore() = default;
+    //Indexes and snapshots hold the address of their store
+    CCitizenStore(const CCitizenStore &) = delete;
+    CCitizenStore & operator=(const CCitizenStore &) = delete;
+
+    Handle add(string_view name, string_view address, string_view account){
+        lock_guard lock(mtx);
+        if(freeRows.empty() && names.size() >= NONE) throw length_error("Citizen store ran out of handles");
+        uint32_t nameId = strings.intern(name), addressId = strings.intern(address), accountId = strings.add(account);
+        if(!freeRows.empty()){
+            Handle h = freeRows.back();
+            freeRows.pop_back();
+            names[h] = nameId;
+            addresses[h] = addressId;
+            accounts[h] = accountId;
+            incomes[h] = expenseSums[h] = 0;
+            bornEpochs[h] = 0;
+            diedEpochs[h] = ALIVE;
+            return h;
+        }
+        names.push_back(nameId);
+        addresses.push_back(addressId);
+        accounts.push_back(accountId);
+        incomes.push_back(0);
+        expenseSums.push_back(0);
+        bornEpochs.push_back(0);
+        diedEpochs.push_back(ALIVE);
+        //Keep room for every row, so release never allocates
+        if(freeRows.capacity() < names.size()) freeRows.reserve(2 * names.size());
+        return names.size() - 1;
+    }
+
+    //The row may be reused by a later add, its strings go back to the pool unless other rows share them
+    void release(Handle h){
+        lock_guard lock(mtx);
+        strings.release(names[h]);
+        strings.release(addresses[h]);
+        strings.release(accounts[h]);
+        freeRows.push_back(h);
+    }
+
+    string_view name(Handle h) const { return strings.get(names[h]); }
+    string_view address(Handle h) const { return strings.get(addresses[h]); }
+    string_view account(Handle h) const { return strings.get(accounts[h]); }
+    NameKey nameKey(Handle h) const { return {name(h), address(h)}; }
+    VersionKey versionKey(Handle h) const { return {nameKey(h), bornEpochs[h]}; }
+
+    int & income(Handle h) { return incomes[h]; }
+    int income(Handle h) const { return incomes[h]; }
+    int & expenses(Handle h) { return expenseSums[h]; }
+    int expenses(Handle h) const { return expenseSums[h]; }
+    uint64_t & bornEpoch(Handle h) { return bornEpochs[h]; }
+    uint64_t bornEpoch(Handle h) const { return bornEpochs[h]; }
+    uint64_t & diedEpoch(Handle h) { return diedEpochs[h]; }
+    uint64_t diedEpoch(Handle h) const { return diedEpochs[h]; }
+
+private:
+    mutex mtx;
+    CStringPool strings;
+    CStableColumn<uint32_t> names;
+    CStableColumn<uint32_t> addresses;
+    CStableColumn<uint32_t> accounts;
+    CStableColumn<int> incomes;
+    CStableColumn<int> expenseSums;
+    CStableColumn<uint64_t> bornEpochs;
+    CStableColumn<uint64_t> diedEpochs;
+    vector<Handle> freeRows;
+};
+
+using Handle = CCitizenStore::Handle;
+
+struct NameCmp{
+    const CCitizenStore * store;
+    bool operator()(Handle a, Handle b) const {
+        return store->versionKey(a) < store->versionKey(b);
+    }
+    bool operator()(Handle a, const VersionKey & b) const {
+        return store->versionKey(a) < b;
+    }
+    bool operator()(const VersionKey & a, Handle b) const {
+        return a < store->versionKey(b);
+    }
+    bool operator()(Handle a, const NameKey & b) const {
+        return store->nameKey(a) < b;
+    }
+    bool operator()(const NameKey & a, Handle b) const {
+        return a < store->nameKey(b);
+    }
+};
+//Account order over every version, versions of a reused account follow each other by birth
+struct AccountCmp{
+    const CCitizenStore * store;
+    bool operator()(Handle a, Handle b) const {
+        string_view x = store->account(a), y = store->account(b);
+        return x != y ? x < y : store->bornEpoch(a) < store->bornEpoch(b);
+    }
+    bool operator()(Handle a, string_view b) const {
+        return store->account(a) < b;
+    }
+    bool operator()(string_view a, Handle b) const {
+        return a < store->account(b);
+    }
+};
+struct AccountOf{
+    const CCitizenStore * store;
+    string_view operator()(Handle h) const {
+        return store->account(h);
+    }
+};
+
+using CNameIndex = CBPlusTree<Handle, NameCmp>;
+using CAccountOrder = CBPlusTree<Handle, AccountCmp>;
+using CAccountIndex = CHashIndex<Handle, AccountOf>;
+
+//Epochs of the snapshots alive at the moment, shared with the snapshots so they can outlive the register
+class CSnapshotRegistry
+{
+public:
+    //The snapshot stays registered until the last copy of the returned token is gone
+    static shared_ptr<void> acquire(const shared_ptr<CSnapshotRegistry> & registry, uint64_t epoch){
+        lock_guard lock(registry->mtx);
+        auto it = registry->epochs.insert(epoch);
+        return shared_ptr<void>(nullptr, [registry, it](void *){
+            lock_guard lock(registry->mtx);
+            registry->epochs.erase(it);
+        });
+    }
+    uint64_t oldest() {
+        lock_guard lock(mtx);
+        return epochs.empty() ? CCitizenStore::ALIVE : *epochs.begin();
+    }
+private:
+    mutex mtx;
+    multiset<uint64_t> epochs;
+};
+
+//Citizens in index order as they were at one epoch. The index may change under the cursor: it then
+//finds its place again by the version it stands on, which the index keeps while the snapshot lives.
+template <typename Index>
+class CSnapshotCursor
+{
+public:
+    //Current citizen, NONE past the end
+    Handle get() const { return current; }
+    const CCitizenStore & store() const { return *citizens; }
+    uint64_t epoch() const { return snapshotEpoch; }
+    void next(){
+        if(current == CCitizenStore::NONE) return;
+        if(index->modifications() != seenModifications){
+            cursor = index->lowerBound(current);
+        }
+        ++cursor;
+        settle();
+    }
+private:
+    friend class CNameVersions;
+    CSnapshotCursor(const Index * index, const CCitizenStore * citizens, typename Index::CCursor start, uint64_t epoch, shared_ptr<void> token)
+            : index(index), citizens(citizens), cursor(start), snapshotEpoch(epoch), token(std::move(token)){
+        settle();
+    }
+    void settle(){
+        while(!cursor.atEnd() && (citizens->bornEpoch(*cursor) > snapshotEpoch || citizens->diedEpoch(*cursor) <= snapshotEpoch)) ++cursor;
+        current = cursor.atEnd() ? CCitizenStore::NONE : *cursor;
+        seenModifications = index->modifications();
+    }
+
+    const Index * index;
+    const CCitizenStore * citizens;
+    typename Index::CCursor cursor;
+    Handle current = CCitizenStore::NONE;
+    uint64_t snapshotEpoch;
+    uint64_t seenModifications = 0;
+    shared_ptr<void> token;
+};
+
+//Name index with multiversion deaths: a death only marks its version as a tombstone, lookups and
+//snapshots younger than the death skip it. Tombstones no snapshot can see any more are dropped by
+//compact, which rebuilds the index in one sweep. It runs by itself once such tombstones exceed
+//compactionRatio of the index, so the dead versions cost amortized O(1) per death.
+//Rows of dropped versions go back to the store. On request the same versions are kept in account order too.
+class CNameVersions
+{
+    static constexpr size_t MIN_COMPACTION = 1024;
+public:
+    explicit CNameVersions(CCitizenStore & citizens, bool ordersAccounts = false)
+            : citizens(citizens), index(NameCmp{&citizens}), accountOrder(AccountCmp{&citizens}), ordersAccounts(ordersAccounts){}
+    //Snapshot cursors hold the address of the index they walk
+    CNameVersions(const CNameVersions &) = delete;
+    CNameVersions & operator=(const CNameVersions &) = delete;
+
+    //The live version of key, NONE if there is none
+    Handle find(const NameKey & key) const {
+        for(auto it = index.lowerBound(key); !it.atEnd() && citizens.nameKey(*it) == key; ++it){
+            if(citizens.diedEpoch(*it) == CCitizenStore::ALIVE) return *it;
+        }
+        return CCitizenStore::NONE;
+    }
+
+    void insert(Handle citizen){
+        citizens.bornEpoch(citizen) = ++epoch;
+        index.insert(citizen);
+        if(ordersAccounts) accountOrder.insert(citizen);
+        //Keep room for a tombstone of every version, so remove never allocates below the threshold
+        if(tombstones.capacity() < index.size()) tombstones.reserve(2 * index.size());
+    }
+
+    void remove(Handle citizen){
+        citizens.diedEpoch(citizen) = ++epoch;
+        tombstones.push_back(citizen);
+        size_t dead = reclaimable();
+        if(dead >= MIN_COMPACTION && dead > compactionRatio * index.size()) compact();
+    }
+
+    //Starts a new epoch for a change made outside the index
+    uint64_t advance(){
+        return ++epoch;
+    }
+
+    //Drops every tombstone no snapshot can see any more. Each order is rebuilt by one linear sweep,
+    //the account order on a second thread.
+    void compact(){
+        uint64_t oldest = snapshots->oldest();
+        auto keep = [this, oldest](Handle h){
+            return citizens.diedEpoch(h) == CCitizenStore::ALIVE || citizens.diedEpoch(h) > oldest;
+        };
+        auto sweep = [&keep](auto & tree){
+            vector<Handle> kept;
+            kept.reserve(tree.size());
+            for(auto it = tree.begin(); !it.atEnd(); ++it){
+                if(keep(*it)) kept.push_back(*it);
+            }
+            tree.assign(std::move(kept));
+        };
+        if(ordersAccounts){
+            thread accounts([this, &sweep]{ sweep(accountOrder); });
+            sweep(index);
+            accounts.join();
+        } else {
+            sweep(index);
+        }
+
+        //Tombstones are kept in order of death, the dropped ones are a prefix
+        size_t dropped = reclaimable(oldest);
+        for(size_t i = 0; i < dropped; i++) citizens.release(tombstones[i]);
+        tombstones.erase(tombstones.begin(), tombstones.begin() + dropped);
+    }
+
+    //Tombstones that may stay until a compaction, as a fraction of the index
+    void setCompactionRatio(double ratio){
+        compactionRatio = ratio;
+    }
+
+    //Number of dead versions in the index
+    size_t tombstoneCount() const {
+        return tombstones.size();
+    }
+
+    //Adds a batch at one epoch, rejects it without changes if a name is already alive.
+    //batch is sorted by name, byAccount holds the same citizens sorted by account.
+    bool merge(vector<Handle> && batch, span<const Handle> byAccount){
+        auto clash = [this](Handle a, Handle b){
+            return citizens.nameKey(a) == citizens.nameKey(b) && citizens.diedEpoch(a) == CCitizenStore::ALIVE;
+        };
+        vector<Handle> merged;
+        merged.reserve(index.size() + batch.size());
+        auto existing = index.begin();
+        for(Handle citizen : batch){
+            while(!existing.atEnd() && citizens.nameKey(*existing) <= citizens.nameKey(citizen)) {
+                if(clash(*existing, citizen)) return false;
+                merged.push_back(*existing);
+                ++existing;
+            }
+            if(!merged.empty() && clash(merged.back(), citizen)) return false;
+            merged.push_back(citizen);
+        }
+        for(; !existing.atEnd(); ++existing) merged.push_back(*existing);
+
+        epoch++;
+        for(Handle citizen : batch) citizens.bornEpoch(citizen) = epoch;
+        index.assign(std::move(merged));
+        if(!ordersAccounts) return true;
+
+        //The batch is the newest epoch, so it goes after every older version of the same account
+        AccountCmp cmp{&citizens};
+        vector<Handle> mergedAccounts;
+        mergedAccounts.reserve(accountOrder.size() + byAccount.size());
+        auto existingAccount = accountOrder.begin();
+        for(Handle citizen : byAccount){
+            for(; !existingAccount.atEnd() && cmp(*existingAccount, citizen); ++existingAccount) mergedAccounts.push_back(*existingAccount);
+            mergedAccounts.push_back(citizen);
+        }
+        for(; !existingAccount.atEnd(); ++existingAccount) mergedAccounts.push_back(*existingAccount);
+        accountOrder.assign(std::move(mergedAccounts));
+        return true;
+    }
+
+    CSnapshotCursor<CNameIndex> snapshot() const {
+        return snapshotAt(index, index.begin());
+    }
+    //Starts at the first citizen not less than from
+    CSnapshotCursor<CNameIndex> snapshot(const NameKey & from) const {
+        return snapshotAt(index, index.lowerBound(from));
+    }
+    //Starts at the first account not less than from, only with ordersAccounts
+    CSnapshotCursor<CAccountOrder> accountSnapshot(string_view from) const {
+        return snapshotAt(accountOrder, accountOrder.lowerBound(from));
+    }
+
+private:
+    template <typename Index>
+    CSnapshotCursor<Index> snapshotAt(const Index & tree, typename Index::CCursor start) const {
+        return CSnapshotCursor<Index>(&tree, &citizens, start, epoch, CSnapshotRegistry::acquire(snapshots, epoch));
+    }
+
+    //Tombstones older than every snapshot
+    size_t reclaimable(uint64_t oldest) const {
+        return partition_point(tombstones.begin(), tombstones.end(), [this, oldest](Handle h){
+            return citizens.diedEpoch(h) <= oldest;
+        }) - tombstones.begin();
+    }
+    size_t reclaimable() const {
+        return tombstones.empty() ? 0 : reclaimable(snapshots->oldest());
+    }
+
+    CCitizenStore & citizens;
+    CNameIndex index;
+    CAccountOrder accountOrder;
+    bool ordersAccounts;
+    uint64_t epoch = 0;
+    vector<Handle> tombstones;
+    double compactionRatio = 0.25;
+    shared_ptr<CSnapshotRegistry> snapshots = make_shared<CSnapshotRegistry>();
+};
+
+//Register image in a file, mapped privately and queried in place without loading. Every position inside
+//the file is an offset from its start, so the image works wherever it gets mapped.
+//Layout: header, rows sorted by name, row numbers sorted by account, heap of length-prefixed strings.
+//Counters and deaths change the private mapping only, the file itself is replaced by write.
+class CRegisterImage
+{
+    struct Header{
+        char magic[8];
+        uint64_t count;
+        uint64_t rows;
+        uint64_t byAccount;
+        uint64_t heap;
+        uint64_t heapSize;
+    };
+    static constexpr char MAGIC[8] = "TAXREG1";
+public:
+    struct Row{
+        uint64_t name;                   //heap offsets
+        uint64_t address;
+        uint64_t account;
+        int income;
+        int expenses;
+        uint64_t diedEpoch;
+    };
+    //One live citizen to be written
+    struct Entry{
+        string_view name;
+        string_view address;
+        string_view account;
+        int income;
+        int expenses;
+    };
+
+    //Lists the rows alive at a register epoch in name order, or in account order when given byAccount
+    class CCursor{
+    public:
+        //Current row, nullptr past the end
+        const Row * get() const { return pos < image->count ? &row(pos) : nullptr; }
+        void next(){
+            if(pos == image->count) return;
+            pos++;
+            settle();
+        }
+    private:
+        friend class CRegisterImage;
+        CCursor(const CRegisterImage * image, const uint32_t * order, size_t pos, uint64_t epoch)
+                : image(image), order(order), epoch(epoch), pos(pos){
+            settle();
+        }
+        const Row & row(size_t i) const {
+            return image->rows[order ? order[i] : i];
+        }
+        void settle(){
+            while(pos < image->count && row(pos).diedEpoch <= epoch) pos++;
+        }
+        const CRegisterImage * image;
+        const uint32_t * order;
+        uint64_t epoch;
+        size_t pos;
+    };
+
+    //An empty image
+    CRegisterImage() = default;
+    explicit CRegisterImage(const string & path){
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) throw runtime_error("Cannot open register image " + path);
+        struct stat info;
+        if(fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(Header)){
+            close(fd);
+            throw runtime_error("Not a register image: " + path);
+        }
+        length = info.st_size;
+        void * mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(mapped == MAP_FAILED) throw runtime_error("Cannot map register image " + path);
+        base = static_cast<char *>(mapped);
+
+        //Every section, offset and row number is checked once here, the lookups trust them afterwards
+        Header header;
+        memcpy(&header, base, sizeof(header));
+        bool valid = memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+                && header.rows % alignof(Row) == 0 && header.byAccount % alignof(uint32_t) == 0
+                && header.rows >= sizeof(Header) && header.rows <= length
+                && header.count <= (length - header.rows) / sizeof(Row) && header.count <= UINT32_MAX
+                && header.byAccount >= header.rows + header.count * sizeof(Row) && header.byAccount <= length
+                && header.count <= (length - header.byAccount) / sizeof(uint32_t)
+                && header.heap >= header.byAccount + header.count * sizeof(uint32_t) && header.heap <= length
+                && header.heapSize <= length - header.heap;
+        if(valid){
+            count = header.count;
+            rows = reinterpret_cast<Row *>(base + header.rows);
+            byAccount = reinterpret_cast<const uint32_t *>(base + header.byAccount);
+            heap = base + header.heap;
+            heapSize = header.heapSize;
+            valid = validRows();
+        }
+        if(!valid){
+            munmap(base, length);
+            base = nullptr;
+            throw runtime_error("Not a register image: " + path);
+        }
+    }
+    CRegisterImage(const CRegisterImage &) = delete;
+    CRegisterImage & operator=(const CRegisterImage &) = delete;
+    ~CRegisterImage(){
+        if(base) munmap(base, length);
+    }
+
+    string_view text(uint64_t offset) const {
+        uint32_t size;
+        memcpy(&size, heap + offset, sizeof(size));
+        return {heap + offset + sizeof(size), size};
+    }
+    NameKey nameKey(const Row & row) const {
+        return {text(row.name), text(row.address)};
+    }
+    const Row & row(size_t i) const {
+        return rows[i];
+    }
+    size_t indexOf(const Row & row) const {
+        return &row - rows;
+    }
+
+    CCursor begin(uint64_t epoch) const {
+        return CCursor(this, nullptr, 0, epoch);
+    }
+    //Starts at the first row not less than from
+    CCursor seekName(uint64_t epoch, const NameKey & from) const {
+        const Row * row = lower_bound(rows, rows + count, from, [this](const Row & r, const NameKey & k){ return nameKey(r) < k; });
+        return CCursor(this, nullptr, row - rows, epoch);
+    }
+    //Starts at the first account not less than from and goes on in account order
+    CCursor seekAccount(uint64_t epoch, string_view from) const {
+        const uint32_t * id = lower_bound(byAccount, byAccount + count, from, [this](uint32_t r, string_view a){ return text(rows[r].account) < a; });
+        return CCursor(this, byAccount, id - byAccount, epoch);
+    }
+
+    //The live row of key, nullptr if there is none
+    Row * findByName(const NameKey & key){
+        Row * row = lower_bound(rows, rows + count, key, [this](const Row & r, const NameKey & k){ return nameKey(r) < k; });
+        return row != rows + count && nameKey(*row) == key && row->diedEpoch == CCitizenStore::ALIVE ? row : nullptr;
+    }
+    const Row * findByName(const NameKey & key) const {
+        return const_cast<CRegisterImage *>(this)->findByName(key);
+    }
+    Row * findByAccount(string_view account){
+        const uint32_t * id = lower_bound(byAccount, byAccount + count, account, [this](uint32_t r, string_view a){ return text(rows[r].account) < a; });
+        if(id == byAccount + count) return nullptr;
+        Row & row = rows[*id];
+        return text(row.account) == account && row.diedEpoch == CCitizenStore::ALIVE ? &row : nullptr;
+    }
+    const Row * findByAccount(string_view account) const {
+        return const_cast<CRegisterImage *>(this)->findByAccount(account);
+    }
+
+    //Writes entries sorted by name to a new image, the old file at path is replaced only once the new one is complete
+    static bool write(const string & path, const vector<Entry> & entries){
+        vector<char> strings;
+        auto add = [&strings](string_view str){
+            uint64_t offset = strings.size();
+            uint32_t size = str.size();
+            strings.insert(strings.end(), reinterpret_cast<const char *>(&size), reinterpret_cast<const char *>(&size) + sizeof(size));
+            strings.insert(strings.end(), str.begin(), str.end());
+            return offset;
+        };
+        unordered_map<string_view, uint64_t> interned;
+        auto intern = [&](string_view str){
+            auto [it, added] = interned.try_emplace(str, 0);
+            if(added) it->second = add(str);
+            return it->second;
+        };
+
+        vector<Row> sortedRows(entries.size());
+        for(size_t i = 0; i < entries.size(); i++){
+            const Entry & e = entries[i];
+            sortedRows[i] = {intern(e.name), intern(e.address), add(e.account), e.income, e.expenses, CCitizenStore::ALIVE};
+        }
+        vector<uint32_t> accountOrder(entries.size());
+        for(size_t i = 0; i < entries.size(); i++) accountOrder[i] = i;
+        sort(accountOrder.begin(), accountOrder.end(), [&entries](uint32_t a, uint32_t b){
+            return entries[a].account < entries[b].account;
+        });
+
+        Header header{};
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.count = entries.size();
+        header.rows = sizeof(Header);
+        header.byAccount = header.rows + sortedRows.size() * sizeof(Row);
+        header.heap = header.byAccount + accountOrder.size() * sizeof(uint32_t);
+        header.heapSize = strings.size();
+
+        string temporary = path + ".tmp";
+        FILE * file = fopen(temporary.c_str(), "wb");
+        if(!file) return false;
+        auto put = [file](const void * data, size_t bytes){
+            return fwrite(data, 1, bytes, file) == bytes;
+        };
+        bool ok = put(&header, sizeof(header))
+                && put(sortedRows.data(), sortedRows.size() * sizeof(Row))
+                && put(accountOrder.data(), accountOrder.size() * sizeof(uint32_t))
+                && put(strings.data(), strings.size())
+                && fflush(file) == 0 && fsync(fileno(file)) == 0;
+        ok = fclose(file) == 0 && ok;
+        if(!ok || rename(temporary.c_str(), path.c_str()) != 0){
+            remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    //Strings lie inside the heap, every citizen is alive on disk and byAccount names rows that exist
+    bool validRows() const {
+        auto validText = [this](uint64_t offset){
+            if(offset > heapSize || heapSize - offset < sizeof(uint32_t)) return false;
+            uint32_t size;
+            memcpy(&size, heap + offset, sizeof(size));
+            return size <= heapSize - offset - sizeof(size);
+        };
+        for(size_t i = 0; i < count; i++){
+            const Row & row = rows[i];
+            if(!validText(row.name) || !validText(row.address) || !validText(row.account)) return false;
+            if(row.diedEpoch != CCitizenStore::ALIVE) return false;
+            if(byAccount[i] >= count) return false;
+        }
+        return true;
+    }
+
+    char * base = nullptr;
+    size_t length = 0;
+    size_t count = 0;
+    Row * rows = nullptr;
+    const uint32_t * byAccount = nullptr;
+    const char * heap = nullptr;
+    uint64_t heapSize = 0;
+};
+
+struct Transaction{
+    enum class EKind : uint8_t { Income, Expense };
+    string_view account;
+    int amount = 0;
+    EKind kind = EKind::Income;
+};
+
+//Totals over a group of citizens
+struct CTaxSummary{
+    size_t count = 0;
+    long long income = 0;
+    long long expenses = 0;
+    int maxIncome = INT_MIN;                //INT_MIN for an empty group
+
+    CTaxSummary & operator+=(const CTaxSummary & other){
+        count += other.count;
+        income += other.income;
+        expenses += other.expenses;
+        maxIncome = max(maxIncome, other.maxIncome);
+        return *this;
+    }
+};
+
+//One step of a progressive tax: rate, in hundredths of a percent, applies to the part of the base above from
+struct CTaxBracket{
+    long long from = 0;
+    int rate = 0;
+};
+
+//Year-end tax of whole columns. The base of a citizen is max(income - expenses, 0) and the tax is the sum of
+//rate * (part of the base inside the bracket) over all brackets, in whole units rounded down.
+//A base is below 2^32, so every part fits the 32x32 bit multiply of AVX2 and a sum never leaves 64 bits.
+//The columns are cut into one block per thread, a block runs the AVX2 kernel when the CPU has it.
+class CTaxEngine
+{
+public:
+    //brackets sorted by from, starting at 0, with rates between 0 and 10000
+    explicit CTaxEngine (span<const CTaxBracket> brackets){
+        for(size_t i = 0; i < brackets.size(); i++){
+            if(brackets[i].rate < 0 || brackets[i].rate > 10000) throw invalid_argument("Tax rate out of range");
+            if(i ? brackets[i].from <= brackets[i - 1].from : brackets[i].from != 0) throw invalid_argument("Tax brackets out of order");
+            long long next = i + 1 < brackets.size() ? brackets[i + 1].from : BASE_LIMIT;
+            steps.push_back({min(brackets[i].from, BASE_LIMIT), min(next, BASE_LIMIT) - min(brackets[i].from, BASE_LIMIT), brackets[i].rate});
+        }
+    }
+
+    //taxes[i] = tax of incomes[i] and expenses[i], threadCount 0 uses every core
+    void compute (span<const int> incomes, span<const int> expenses, span<long long> taxes, size_t threadCount = 0) const {
+        size_t count = min({incomes.size(), expenses.size(), taxes.size()});
+        if(!threadCount) threadCount = max(1u, thread::hardware_concurrency());
+        size_t blocks = min(threadCount, (count + MIN_BLOCK - 1) / MIN_BLOCK);
+        if(blocks <= 1) return computeBlock(incomes.data(), expenses.data(), taxes.data(), count);
+
+        vector<thread> threads;
+        size_t block = (count + blocks - 1) / blocks;
+        for(size_t from = block; from < count; from += block){
+            size_t size = min(block, count - from);
+            threads.emplace_back([this, &incomes, &expenses, &taxes, from, size]{
+                computeBlock(incomes.data() + from, expenses.data() + from, taxes.data() + from, size);
+            });
+        }
+        computeBlock(incomes.data(), expenses.data(), taxes.data(), block);
+        for(thread & th : threads) th.join();
+    }
+
+    //The scalar kernel for a single citizen
+    long long tax (int income, int expenses) const {
+        long long base = max((long long)income - expenses, 0LL);
+        unsigned long long sum = 0;
+        for(const Step & step : steps) sum += (unsigned long long)clamp(base - step.lower, 0LL, step.width) * step.rate;
+        return sum / 10000;
+    }
+private:
+    struct Step{
+        long long lower;
+        long long width;
+        long long rate;
+    };
+    static constexpr long long BASE_LIMIT = 1LL << 32;
+    static constexpr size_t MIN_BLOCK = 1 << 16;        //smaller blocks cost more to start than to compute
+
+    void computeBlock (const int * incomes, const int * expenses, long long * taxes, size_t count) const {
+        size_t done = 0;
+#if defined(__x86_64__)
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        if(avx2) done = computeAvx2(incomes, expenses, taxes, count);
+#endif
+        for(size_t i = done; i < count; i++) taxes[i] = tax(incomes[i], expenses[i]);
+    }
+
+#if defined(__x86_64__)
+    //Four citizens at a time, returns how many were computed. The division by 10000 goes through doubles:
+    //a sum is below 2^52, so it converts exactly by the 2^52 bias and the rounded quotient floors correctly.
+    __attribute__((target("avx2"))) size_t computeAvx2 (const int * incomes, const int * expenses, long long * taxes, size_t count) const {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i biasBits = _mm256_set1_epi64x(0x4330000000000000LL);
+        const __m256d bias = _mm256_set1_pd(0x1p52);
+        const __m256d divisor = _mm256_set1_pd(10000.0);
+        size_t i = 0;
+        for(; i + 4 <= count; i += 4){
+            __m256i base = _mm256_sub_epi64(_mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(incomes + i))),
+                                            _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(expenses + i))));
+            base = _mm256_andnot_si256(_mm256_cmpgt_epi64(zero, base), base);
+            __m256i sum = zero;
+            for(const Step & step : steps){
+                __m256i part = _mm256_sub_epi64(base, _mm256_set1_epi64x(step.lower));
+                part = _mm256_andnot_si256(_mm256_cmpgt_epi64(zero, part), part);
+                __m256i width = _mm256_set1_epi64x(step.width);
+                part = _mm256_blendv_epi8(part, width, _mm256_cmpgt_epi64(part, width));
+                sum = _mm256_add_epi64(sum, _mm256_mul_epu32(part, _mm256_set1_epi64x(step.rate)));
+            }
+            __m256d exact = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(sum, biasBits)), bias);
+            __m256d whole = _mm256_add_pd(_mm256_floor_pd(_mm256_div_pd(exact, divisor)), bias);
+            _mm256_storeu_si256((__m256i *)(taxes + i), _mm256_xor_si256(_mm256_castpd_si256(whole), biasBits));
+        }
+        return i;
+    }
+#endif
+
+    vector<Step> steps;
+};
+
+//CSV lines of the register: name,address,account,income,expenses. A field with a comma or a quote is quoted,
+//quotes inside doubled. A record never spans lines, so a dump splits into chunks at any line break.
+struct CCsvFormat{
+    static constexpr string_view HEADER = "name,address,account,income,expenses";
+
+    struct Record{
+        string_view name;
+        string_view address;
+        string_view account;
+        int income;
+        int expenses;
+    };
+
+    //Appends one line to out, false for a field with a line break, which no line can hold
+    static bool append (string & out, const Record & record){
+        for(string_view field : {record.name, record.address, record.account}){
+            if(field.find_first_of("\r\n") != string_view::npos) return false;
+            if(field.find_first_of(",\"") == string_view::npos) out += field;
+            else {
+                out += '"';
+                for(char c : field){
+                    if(c == '"') out += '"';
+                    out += c;
+                }
+                out += '"';
+            }
+            out += ',';
+        }
+        char digits[24];
+        out.append(digits, to_chars(digits, digits + sizeof(digits), record.income).ptr);
+        out += ',';
+        out.append(digits, to_chars(digits, digits + sizeof(digits), record.expenses).ptr);
+        out += '\n';
+        return true;
+    }
+
+    //Parses the line [pos, end) without its line break. Quoted fields are unescaped in place, the views
+    //of record point into the line. False if the line is malformed.
+    static bool parse (char * pos, char * end, Record & record){
+        string_view * texts[] = {&record.name, &record.address, &record.account};
+        for(string_view * text : texts){
+            if(pos < end && *pos == '"'){
+                char * out = ++pos, * from = out;
+                for(;; pos++){
+                    if(pos == end) return false;
+                    if(*pos == '"' && (++pos == end || *pos != '"')) break;
+                    *out++ = *pos;
+                }
+                *text = string_view(from, out - from);
+            } else {
+                char * from = pos;
+                while(pos < end && *pos != ',') pos++;
+                *text = string_view(from, pos - from);
+            }
+            if(pos == end || *pos++ != ',') return false;
+        }
+        auto [afterIncome, incomeError] = from_chars(pos, end, record.income);
+        if(incomeError != errc() || afterIncome == end || *afterIncome != ',') return false;
+        auto [afterExpenses, expensesError] = from_chars(afterIncome + 1, end, record.expenses);
+        return expensesError == errc() && afterExpenses == end;
+    }
+};
+
+//A live citizen of either layer: a store handle shifted left, or an image row shifted left with the low bit set
+using CitizenRef = uint32_t;
+
+//Live citizens in key order with subtree totals, for reporting. A treap kept in one arena: every node knows
+//its parent, so a changed counter is pushed up to the root without any key comparison.
+//Range totals, ranks and selection take one descent, the richest citizens are found through subtree maxima.
+template <typename KeyOf>
+class CReportIndex
+{
+    static constexpr uint32_t NIL = UINT32_MAX;
+    struct Node{
+        CitizenRef ref;
+        uint32_t priority;
+        uint32_t left = NIL;
+        uint32_t right = NIL;
+        uint32_t parent = NIL;
+        int income = 0;
+        int expenses = 0;
+        CTaxSummary total;
+    };
+public:
+    struct Item{
+        CitizenRef ref;
+        int income;
+        int expenses;
+    };
+
+    explicit CReportIndex(KeyOf keyOf) : keyOf(keyOf){}
+
+    //Replaces the contents with items sorted by key, in linear time
+    void assign(const vector<Item> & sorted){
+        nodes.clear();
+        freeNodes.clear();
+        nodeOf.clear();
+        root = NIL;
+        vector<uint32_t> spine;
+        for(const Item & item : sorted){
+            uint32_t x = alloc(item);
+            uint32_t last = NIL;
+            while(!spine.empty() && nodes[spine.back()].priority < nodes[x].priority){
+                last = spine.back();
+                spine.pop_back();
+            }
+            nodes[x].left = last;
+            if(last != NIL) nodes[last].parent = x;
+            if(!spine.empty()){
+                nodes[spine.back()].right = x;
+                nodes[x].parent = spine.back();
+            }
+            spine.push_back(x);
+        }
+        if(spine.empty()) return;
+        root = spine.front();
+
+        //Totals bottom-up, every node after both of its children
+        vector<pair<uint32_t, bool>> stack{{root, false}};
+        while(!stack.empty()){
+            auto [x, childrenDone] = stack.back();
+            stack.pop_back();
+            if(childrenDone){
+                recompute(x);
+                continue;
+            }
+            stack.push_back({x, true});
+            if(nodes[x].left != NIL) stack.push_back({nodes[x].left, false});
+            if(nodes[x].right != NIL) stack.push_back({nodes[x].right, false});
+        }
+    }
+
+    void insert(const Item & item){
+        uint32_t x = alloc(item);
+        NameKey key = keyOf(item.ref);
+        uint32_t parent = NIL;
+        bool left = false;
+        for(uint32_t n = root; n != NIL; n = left ? nodes[n].left : nodes[n].right){
+            parent = n;
+            left = key < keyOf(nodes[n].ref);
+        }
+        nodes[x].parent = parent;
+        if(parent == NIL) root = x;
+        else (left ? nodes[parent].left : nodes[parent].right) = x;
+        recompute(x);
+        while(nodes[x].parent != NIL && nodes[nodes[x].parent].priority < nodes[x].priority) rotateUp(x);
+        refreshUp(nodes[x].parent);
+    }
+
+    void erase(CitizenRef ref){
+        uint32_t x = nodeOf[ref];
+        //Sink the node to a leaf, always lifting the child with the higher priority
+        for(;;){
+            uint32_t l = nodes[x].left, r = nodes[x].right;
+            if(l == NIL && r == NIL) break;
+            rotateUp(r == NIL || (l != NIL && nodes[l].priority > nodes[r].priority) ? l : r);
+        }
+        uint32_t parent = nodes[x].parent;
+        if(parent == NIL) root = NIL;
+        else (nodes[parent].left == x ? nodes[parent].left : nodes[parent].right) = NIL;
+        refreshUp(parent);
+        nodeOf[ref] = NIL;
+        freeNodes.push_back(x);
+    }
+
+    //New counters of a citizen
+    void update(CitizenRef ref, int income, int expenses){
+        uint32_t x = nodeOf[ref];
+        nodes[x].income = income;
+        nodes[x].expenses = expenses;
+        refreshUp(x);
+    }
+
+    CTaxSummary total() const {
+        return root == NIL ? CTaxSummary() : nodes[root].total;
+    }
+
+    //Totals of citizens with from <= name <= to
+    CTaxSummary between(string_view from, string_view to) const {
+        uint32_t n = root;
+        //The topmost node in the range, the two bounds are followed separately below it
+        while(n != NIL){
+            string_view name = keyOf(nodes[n].ref).name;
+            if(name < from) n = nodes[n].right;
+            else if(name > to) n = nodes[n].left;
+            else break;
+        }
+        if(n == NIL) return {};
+        CTaxSummary sum = own(n);
+        for(uint32_t m = nodes[n].left; m != NIL;){
+            if(keyOf(nodes[m].ref).name < from){
+                m = nodes[m].right;
+                continue;
+            }
+            sum += own(m);
+            sum += totalOf(nodes[m].right);
+            m = nodes[m].left;
+        }
+        for(uint32_t m = nodes[n].right; m != NIL;){
+            if(keyOf(nodes[m].ref).name > to){
+                m = nodes[m].left;
+                continue;
+            }
+            sum += own(m);
+            sum += totalOf(nodes[m].left);
+            m = nodes[m].right;
+        }
+        return sum;
+    }
+
+    //Number of citizens whose key is less than key
+    size_t rank(const NameKey & key) const {
+        size_t before = 0;
+        for(uint32_t n = root; n != NIL;){
+            if(keyOf(nodes[n].ref) < key){
+                before += totalOf(nodes[n].left).count + 1;
+                n = nodes[n].right;
+            } else {
+                n = nodes[n].left;
+            }
+        }
+        return before;
+    }
+
+    //The citizen at position k in key order, NIL past the end
+    CitizenRef select(size_t k) const {
+        for(uint32_t n = root; n != NIL;){
+            size_t leftCount = totalOf(nodes[n].left).count;
+            if(k == leftCount) return nodes[n].ref;
+            if(k < leftCount){
+                n = nodes[n].left;
+            } else {
+                k -= leftCount + 1;
+                n = nodes[n].right;
+            }
+        }
+        return NIL;
+    }
+
+    //Up to count citizens with the highest income, richest first
+    vector<CitizenRef> top(size_t count) const {
+        //Entries are whole subtrees keyed by their maximum, or single nodes keyed by their own income
+        using Entry = tuple<int, uint32_t, bool>;
+        priority_queue<Entry> queue;
+        if(root != NIL) queue.emplace(nodes[root].total.maxIncome, root, false);
+        vector<CitizenRef> result;
+        while(result.size() < count && !queue.empty()){
+            auto [income, n, single] = queue.top();
+            queue.pop();
+            if(single){
+                result.push_back(nodes[n].ref);
+                continue;
+            }
+            queue.emplace(nodes[n].income, n, true);
+            if(nodes[n].left != NIL) queue.emplace(nodes[nodes[n].left].total.maxIncome, nodes[n].left, false);
+            if(nodes[n].right != NIL) queue.emplace(nodes[nodes[n].right].total.maxIncome, nodes[n].right, false);
+        }
+        return result;
+    }
+
+private:
+    uint32_t alloc(const Item & item){
+        uint32_t x;
+        if(!freeNodes.empty()){
+            x = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[x] = Node();
+        } else {
+            x = nodes.size();
+            nodes.emplace_back();
+        }
+        Node & node = nodes[x];
+        node.ref = item.ref;
+        node.priority = rng();
+        node.income = item.income;
+        node.expenses = item.expenses;
+        node.total = own(x);
+        if(nodeOf.size() <= item.ref) nodeOf.resize(max<size_t>(item.ref + 1, 2 * nodeOf.size()), NIL);
+        nodeOf[item.ref] = x;
+        return x;
+    }
+
+    CTaxSummary own(uint32_t n) const {
+        return {1, nodes[n].income, nodes[n].expenses, nodes[n].income};
+    }
+    CTaxSummary totalOf(uint32_t n) const {
+        return n == NIL ? CTaxSummary() : nodes[n].total;
+    }
+    void recompute(uint32_t n){
+        CTaxSummary sum = totalOf(nodes[n].left);
+        sum += own(n);
+        sum += totalOf(nodes[n].right);
+        nodes[n].total = sum;
+    }
+    void refreshUp(uint32_t n){
+        for(; n != NIL; n = nodes[n].parent) recompute(n);
+    }
+
+    //Moves x one level up in place of its parent, keeping the key order
+    void rotateUp(uint32_t x){
+        uint32_t p = nodes[x].parent, g = nodes[p].parent;
+        if(nodes[p].left == x){
+            nodes[p].left = nodes[x].right;
+            if(nodes[x].right != NIL) nodes[nodes[x].right].parent = p;
+            nodes[x].right = p;
+        } else {
+            nodes[p].right = nodes[x].left;
+            if(nodes[x].left != NIL) nodes[nodes[x].left].parent = p;
+            nodes[x].left = p;
+        }
+        nodes[p].parent = x;
+        nodes[x].parent = g;
+        if(g == NIL) root = x;
+        else (nodes[g].left == p ? nodes[g].left : nodes[g].right) = x;
+        recompute(p);
+        recompute(x);
+    }
+
+    vector<Node> nodes;
+    vector<uint32_t> freeNodes;
+    vector<uint32_t> nodeOf;                //node of every citizen ref
+    uint32_t root = NIL;
+    mt19937 rng{20240601};
+    [[no_unique_address]] KeyOf keyOf;
+};
+
+//Listing orders: the key range bounds apply to, and which of two citizens from the two layers comes first
+struct ByName{
+    using Index = CNameIndex;
+    static string_view key(const CCitizenStore & store, Handle h){ return store.name(h); }
+    static string_view key(const CRegisterImage & image, const CRegisterImage::Row & row){ return image.text(row.name); }
+    static bool before(const CRegisterImage & image, const CRegisterImage::Row & row, const CCitizenStore & store, Handle h){
+        return image.nameKey(row) < store.nameKey(h);
+    }
+};
+struct ByAccount{
+    using Index = CAccountOrder;
+    static string_view key(const CCitizenStore & store, Handle h){ return store.account(h); }
+    static string_view key(const CRegisterImage & image, const CRegisterImage::Row & row){ return image.text(row.account); }
+    static bool before(const CRegisterImage & image, const CRegisterImage::Row & row, const CCitizenStore & store, Handle h){
+        return key(image, row) < key(store, h);
+    }
+};
+
+//Upper end of a listing, a key is past it when its first length characters sort after last
+class CKeyBound
+{
+public:
+    //No upper end
+    CKeyBound() = default;
+    explicit CKeyBound(string last, size_t length = string::npos) : last(std::move(last)), length(length), bounded(true){}
+    bool past(string_view key) const {
+        return bounded && key.substr(0, length) > last;
+    }
+private:
+    string last;
+    size_t length = string::npos;
+    bool bounded = false;
+};
+
+//Lists the register as it was when the iterator was made, later births and deaths do not disturb it.
+//Citizens from the image and those changed since are merged in the order of Order.
+template <typename Order>
+class CListIterator
+{
+public:
+    CListIterator(CSnapshotCursor<typename Order::Index> cursor, CRegisterImage::CCursor base, const CRegisterImage & image, CKeyBound bound = CKeyBound())
+            : cursor(std::move(cursor)), image(&image), base(base), bound(std::move(bound)){
+        load();
+    }
+    bool atEnd () const{
+        return ended;
+    }
+    void next (){
+        if(ended) return;
+        if(fromBase) base.next();
+        else cursor.next();
+        load();
+    }
+    const std::string & name () const {
+        return nameBuf;
+    }
+
+    const std::string & addr () const {
+        return addrBuf;
+    }
+
+    const std::string & account () const {
+        return accountBuf;
+    }
+private:
+    //The store keeps no std::string, the current row is copied out, reusing the buffers
+    void load(){
+        const CRegisterImage::Row * row = base.get();
+        Handle citizen = cursor.get();
+        ended = !row && citizen == CCitizenStore::NONE;
+        if(!ended){
+            fromBase = row && (citizen == CCitizenStore::NONE || Order::before(*image, *row, cursor.store(), citizen));
+            ended = bound.past(fromBase ? Order::key(*image, *row) : Order::key(cursor.store(), citizen));
+        }
+        if(ended){
+            nameBuf.clear();
+            addrBuf.clear();
+            accountBuf.clear();
+            return;
+        }
+        if(fromBase){
+            nameBuf.assign(image->text(row->name));
+            addrBuf.assign(image->text(row->address));
+            accountBuf.assign(image->text(row->account));
+            return;
+        }
+        nameBuf.assign(cursor.store().name(citizen));
+        addrBuf.assign(cursor.store().address(citizen));
+        accountBuf.assign(cursor.store().account(citizen));
+    }
+
+    CSnapshotCursor<typename Order::Index> cursor;
+    const CRegisterImage * image;
+    CRegisterImage::CCursor base;
+    CKeyBound bound;
+    bool fromBase = false;
+    bool ended = false;
+    string nameBuf;
+    string addrBuf;
+    string accountBuf;
+};
+
+using CIterator = CListIterator<ByName>;
+using CAccountIterator = CListIterator<ByAccount>;
+
+class CTaxRegister
+{
+public:
+    CTaxRegister() = default;
+    //Not copyable or movable: the indexes compare through the address of the member store
+    CTaxRegister(const CTaxRegister &) = delete;
+    CTaxRegister & operator=(const CTaxRegister &) = delete;
+
+    //Opens a register saved by save, the image is mapped and queried in place instead of being loaded.
+    //Changes go to the usual indexes on top of it and reach the file only with the next save.
+    static CTaxRegister open (const std::string & path){
+        return CTaxRegister(path);
+    }
+
+    //Writes every live citizen to an image at path, false if the file could not be written
+    bool save (const std::string & path) const {
+        vector<CRegisterImage::Entry> entries;
+        forEachLive([&entries](CitizenRef, const NameKey & key, string_view account, int income, int expenses){
+            entries.push_back({key.name, key.address, account, income, expenses});
+        });
+        return CRegisterImage::write(path, entries);
+    }
+
+    //Writes every live citizen as CSV in name order, false if the file could not be written or a field holds
+    //a line break. The listing is cut into chunks that threadCount threads format side by side (0 for every core).
+    bool exportCsv (const std::string & path, size_t threadCount = 0) const {
+        FILE * file = fopen(path.c_str(), "wb");
+        if(!file) return false;
+        if(!threadCount) threadCount = max(1u, thread::hardware_concurrency());
+        vector<vector<CCsvFormat::Record>> chunks(threadCount);
+        vector<string> texts(threadCount);
+        size_t filled = 0;
+        bool ok = fwrite(CCsvFormat::HEADER.data(), 1, CCsvFormat::HEADER.size(), file) == CCsvFormat::HEADER.size()
+                && fputc('\n', file) != EOF;
+        atomic<bool> formatted = true;
+        auto flush = [&]{
+            vector<thread> threads;
+            auto format = [&chunks, &texts, &formatted](size_t i){
+                texts[i].clear();
+                for(const CCsvFormat::Record & record : chunks[i]){
+                    if(!CCsvFormat::append(texts[i], record)) formatted = false;
+                }
+                chunks[i].clear();
+            };
+            for(size_t i = 1; i < filled; i++) threads.emplace_back(format, i);
+            if(filled) format(0);
+            for(thread & th : threads) th.join();
+            for(size_t i = 0; i < filled; i++) ok = ok && fwrite(texts[i].data(), 1, texts[i].size(), file) == texts[i].size();
+            filled = 0;
+        };
+        forEachLive([&](CitizenRef, const NameKey & key, string_view account, int income, int expenses){
+            if(chunks[filled].size() == CSV_CHUNK && ++filled == chunks.size()) flush();
+            chunks[filled].push_back({key.name, key.address, account, income, expenses});
+        });
+        if(!chunks[filled].empty()) filled++;
+        flush();
+        ok = fclose(file) == 0 && ok && formatted;
+        if(!ok) remove(path.c_str());
+        return ok;
+    }
+    //Registers every citizen of a CSV dump written by exportCsv, either all of them or none, see bulkBirth.
+    //The file is mapped and cut at line breaks into one chunk per thread, chunks are parsed side by side.
+    //False if the file cannot be read, a line is malformed or the citizens clash.
+    bool importCsv (const std::string & path, size_t threadCount = 0){
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+        struct stat info;
+        if(fstat(fd, &info) != 0){
+            close(fd);
+            return false;
+        }
+        size_t length = info.st_size;
+        if(!length){
+            close(fd);
+            return true;
+        }
+        //Private and writable, so quoted fields can be unescaped in place
+        void * mapped = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(mapped == MAP_FAILED) return false;
+        char * data = static_cast<char *>(mapped), * end = data + length;
+        if(string_view(data, length).starts_with(CCsvFormat::HEADER) && (length == CCsvFormat::HEADER.size()
+                || data[CCsvFormat::HEADER.size()] == '\n' || data[CCsvFormat::HEADER.size()] == '\r')){
+            data += CCsvFormat::HEADER.size();
+        }
+
+        struct Chunk{
+            char * from;
+            char * to;
+            vector<tuple<string_view, string_view, string_view>> records = {};
+            vector<Transaction> amounts = {};
+            bool ok = true;
+        };
+        if(!threadCount) threadCount = max(1u, thread::hardware_concurrency());
+        vector<Chunk> chunks;
+        for(char * from = data; from < end;){
+            char * to = from + max<size_t>((end - data) / threadCount, 1);
+            to = to < end ? static_cast<char *>(memchr(to, '\n', end - to)) : nullptr;
+            to = to ? to + 1 : end;
+            chunks.push_back({from, to});
+            from = to;
+        }
+        auto parse = [](Chunk & chunk){
+            for(char * line = chunk.from; line < chunk.to;){
+                char * lineEnd = static_cast<char *>(memchr(line, '\n', chunk.to - line));
+                char * next = lineEnd ? lineEnd + 1 : chunk.to;
+                if(!lineEnd) lineEnd = chunk.to;
+                if(lineEnd > line && lineEnd[-1] == '\r') lineEnd--;
+                if(lineEnd > line){
+                    CCsvFormat::Record record;
+                    if(!CCsvFormat::parse(line, lineEnd, record)){
+                        chunk.ok = false;
+                        return;
+                    }
+                    chunk.records.emplace_back(record.name, record.address, record.account);
+                    if(record.income) chunk.amounts.push_back({record.account, record.income, Transaction::EKind::Income});
+                    if(record.expenses) chunk.amounts.push_back({record.account, record.expenses, Transaction::EKind::Expense});
+                }
+                line = next;
+            }
+        };
+        vector<thread> threads;
+        for(size_t i = 1; i < chunks.size(); i++) threads.emplace_back(parse, ref(chunks[i]));
+        if(!chunks.empty()) parse(chunks[0]);
+        for(thread & th : threads) th.join();
+
+        bool ok = all_of(chunks.begin(), chunks.end(), [](const Chunk & chunk){ return chunk.ok; });
+        if(ok){
+            vector<tuple<string_view, string_view, string_view>> records;
+            vector<Transaction> amounts;
+            for(Chunk & chunk : chunks){
+                records.insert(records.end(), chunk.records.begin(), chunk.records.end());
+                amounts.insert(amounts.end(), chunk.amounts.begin(), chunk.amounts.end());
+            }
+            ok = bulkBirth(records);
+            if(ok) applyBatch(amounts);
+        }
+        munmap(mapped, length);
+        return ok;
+    }
+
+    bool birth (const std::string & name, const std::string & addr, const std::string & account){
+        if(findByName(name, addr) != CCitizenStore::NONE || image.findByName({name, addr})) return false;
+        if(dataByAccounts.find(account) || image.findByAccount(account)) return false;
+
+        Handle newCitizen = citizens.add(name, addr, account);
+        dataByAccounts.insert(newCitizen);
+        dataByNames.insert(newCitizen);
+        if(reports) reports->insert({refOf(newCitizen), 0, 0});
+        return true;
+    }
+
+
+    bool death (const std::string & name, const std::string & addr){
+        Handle citizen = findByName(name, addr);
+        if(citizen == CCitizenStore::NONE){
+            //Image rows stay in place, snapshots older than the death still list them
+            CRegisterImage::Row * row = image.findByName({name, addr});
+            if(!row) return false;
+            row->diedEpoch = dataByNames.advance();
+            if(reports) reports->erase(refOf(*row));
+            return true;
+        }
+
+        if(reports) reports->erase(refOf(citizen));
+        dataByAccounts.erase(citizens.account(citizen));
+        dataByNames.remove(citizen);
+        return true;
+    }
+
+    bool income (const std::string & account, int amount){
+        CSums sums = sumsByAccount(account);
+        if(!sums.income) return false;
+
+        *sums.income += amount;
+        changed(sums);
+        return true;
+    }
+    bool income (const std::string & name, const std::string & addr, int amount){
+        CSums sums = sumsByName(name, addr);
+        if(!sums.income) return false;
+
+        *sums.income += amount;
+        changed(sums);
+        return true;
+    }
+    bool expense (const std::string & account, int amount){
+        CSums sums = sumsByAccount(account);
+        if(!sums.expenses) return false;
+
+        *sums.expenses += amount;
+        changed(sums);
+        return true;
+    }
+    bool expense (const std::string & name, const std::string& addr, int amount){
+        CSums sums = sumsByName(name, addr);
+        if(!sums.expenses) return false;
+
+        *sums.expenses += amount;
+        changed(sums);
+        return true;
+    }
+    bool audit (const std::string & name, const std::string & addr,
+                std::string & account, int & sumIncome, int & sumExpense) const {
+        Handle citizen = findByName(name, addr);
+        if(citizen == CCitizenStore::NONE){
+            const CRegisterImage::Row * row = image.findByName({name, addr});
+            if(!row) return false;
+
+            account = image.text(row->account);
+            sumIncome = row->income;
+            sumExpense = row->expenses;
+            return true;
+        }
+
+        account = citizens.account(citizen);
+        sumIncome = citizens.income(citizen);
+        sumExpense = citizens.expenses(citizen);
+        return true;
+    }
+    //Deaths leave tombstones in the ordered indexes, this drops those no listing needs any more.
+    //It also runs by itself once tombstones exceed the compaction ratio of the population.
+    void compact (){
+        dataByNames.compact();
+    }
+    void setCompactionRatio (double ratio){
+        dataByNames.setCompactionRatio(ratio);
+    }
+    size_t tombstones () const{
+        return dataByNames.tombstoneCount();
+    }
+    //Registers a whole batch of (name, addr, account) records at once, either all of them or none.
+    //Both sort orders are built once on two threads, duplicates are found in a single linear pass.
+    template <typename Range>
+    bool bulkBirth (const Range & records){
+        vector<Handle> byName;
+        for(const auto & [name, addr, account] : records){
+            byName.push_back(citizens.add(name, addr, account));
+        }
+        if(byName.empty()) return true;
+
+        vector<Handle> byAccount(byName);
+        thread accountSort([this, &byAccount]{
+            sort(byAccount.begin(), byAccount.end(), [this](Handle a, Handle b){
+                return citizens.account(a) < citizens.account(b);
+            });
+        });
+        //A dump written in name order, such as exportCsv, needs no sorting
+        if(!is_sorted(byName.begin(), byName.end(), NameCmp{&citizens})) sort(byName.begin(), byName.end(), NameCmp{&citizens});
+        accountSort.join();
+
+        auto reject = [this, &byAccount]{
+            for(Handle citizen : byAccount) citizens.release(citizen);
+            return false;
+        };
+        for(size_t i = 0; i < byAccount.size(); i++){
+            if(i > 0 && citizens.account(byAccount[i - 1]) == citizens.account(byAccount[i])) return reject();
+            if(dataByAccounts.find(citizens.account(byAccount[i])) || image.findByAccount(citizens.account(byAccount[i]))) return reject();
+        }
+        for(Handle citizen : byName){
+            if(image.findByName(citizens.nameKey(citizen))) return reject();
+        }
+
+        //Merge with the current population, a name clash anywhere rejects the whole batch
+        if(!dataByNames.merge(std::move(byName), byAccount)) return reject();
+
+        dataByAccounts.reserve(dataByAccounts.size() + byAccount.size());
+        for(Handle citizen : byAccount) dataByAccounts.insert(citizen);
+        //Rebuilding on the next report is cheaper than inserting a large batch one by one
+        reports.reset();
+        return true;
+    }
+    //Applies a batch of account-keyed transactions, every affected citizen is looked up and updated once.
+    //Bit i of the result tells whether transactions[i] found its account.
+    vector<bool> applyBatch (span<const Transaction> transactions){
+        struct Entry{
+            uint64_t slot;
+            uint32_t hash;
+            uint32_t index;
+        };
+        vector<Entry> order(transactions.size());
+        for(size_t i = 0; i < transactions.size(); i++){
+            uint32_t h = CAccountIndex::hashOf(transactions[i].account);
+            order[i] = {dataByAccounts.homeSlot(h), h, static_cast<uint32_t>(i)};
+        }
+        //Grouped in hash table order, so the lookups sweep the table front to back
+        sort(order.begin(), order.end(), [](const Entry & a, const Entry & b){
+            return tie(a.slot, a.hash, a.index) < tie(b.slot, b.hash, b.index);
+        });
+
+        vector<bool> applied(transactions.size(), false);
+        for(size_t from = 0, to = 0; from < order.size(); from = to){
+            while(to < order.size() && order[to].hash == order[from].hash) to++;
+
+            string_view account = transactions[order[from].index].account;
+            CSums sums = sumsByAccount(account, order[from].hash);
+            for(size_t i = from; i < to; i++){
+                const Transaction & t = transactions[order[i].index];
+                //A different account under the same hash is applied on its own
+                if(t.account != account){
+                    CSums other = sumsByAccount(t.account, order[i].hash);
+                    if(!other.income) continue;
+                    *(t.kind == Transaction::EKind::Income ? other.income : other.expenses) += t.amount;
+                    changed(other);
+                    applied[order[i].index] = true;
+                    continue;
+                }
+                if(!sums.income) continue;
+                //Added one by one in batch order, exactly as the income/expense calls would
+                *(t.kind == Transaction::EKind::Income ? sums.income : sums.expenses) += t.amount;
+                applied[order[i].index] = true;
+            }
+            if(sums.income) changed(sums);
+        }
+        return applied;
+    }
+    CIterator listByName () const{
+        auto changes = dataByNames.snapshot();
+        auto base = image.begin(changes.epoch());
+        return CIterator(std::move(changes), base, image);
+    }
+    //Citizens with fromName <= name <= toName, found with one search and then listed in order
+    CIterator listByName (const std::string & fromName, const std::string & toName) const{
+        auto changes = dataByNames.snapshot({fromName, {}});
+        auto base = image.seekName(changes.epoch(), {fromName, {}});
+        return CIterator(std::move(changes), base, image, CKeyBound(toName));
+    }
+    //Citizens whose name starts with prefix
+    CIterator listByNamePrefix (const std::string & prefix) const{
+        auto changes = dataByNames.snapshot({prefix, {}});
+        auto base = image.seekName(changes.epoch(), {prefix, {}});
+        return CIterator(std::move(changes), base, image, CKeyBound(prefix, prefix.size()));
+    }
+    //Totals of citizens with fromName <= name <= toName
+    CTaxSummary summarize (const std::string & fromName, const std::string & toName) const{
+        return reportIndex().between(fromName, toName);
+    }
+    //Totals of the whole register
+    CTaxSummary summarize () const{
+        return reportIndex().total();
+    }
+    //Number of citizens listed by listByName before (name, addr), whether or not it is alive
+    size_t rank (const std::string & name, const std::string & addr) const{
+        return reportIndex().rank({name, addr});
+    }
+    //The citizen at position k of listByName, false past the end
+    bool nth (size_t k, std::string & name, std::string & addr) const{
+        CitizenRef ref = reportIndex().select(k);
+        if(ref == UINT32_MAX) return false;
+        NameKey key = keyOf(ref);
+        name = key.name;
+        addr = key.address;
+        return true;
+    }
+    //Up to count citizens with the highest income as (name, addr, income), richest first
+    vector<tuple<string, string, int>> topEarners (size_t count) const{
+        vector<tuple<string, string, int>> result;
+        for(CitizenRef ref : reportIndex().top(count)){
+            NameKey key = keyOf(ref);
+            result.emplace_back(key.name, key.address, incomeOf(ref));
+        }
+        return result;
+    }
+    //Tax of every citizen under brackets, taxes[i] for the i-th citizen of listByName.
+    //False if taxes is shorter than the population, nothing is written then.
+    //The counters live in chunks and in the image rows, so they are gathered in name order first
+    //and the engine runs over the gathered columns; the walk costs more than the kernel.
+    bool computeTaxes (span<const CTaxBracket> brackets, span<long long> taxes, size_t threadCount = 0) const{
+        CTaxEngine engine(brackets);
+        vector<int> incomes, expenses;
+        forEachLive([&incomes, &expenses](CitizenRef, const NameKey &, string_view, int income, int expense){
+            incomes.push_back(income);
+            expenses.push_back(expense);
+        });
+        if(taxes.size() < incomes.size()) return false;
+        engine.compute(incomes, expenses, taxes, threadCount);
+        return true;
+    }
+    //Citizens with fromAccount <= account <= toAccount in account order
+    CAccountIterator listByAccount (const std::string & fromAccount, const std::string & toAccount) const{
+        auto changes = dataByNames.accountSnapshot(fromAccount);
+        auto base = image.seekAccount(changes.epoch(), fromAccount);
+        return CAccountIterator(std::move(changes), base, image, CKeyBound(toAccount));
+    }
+private:
+    //Counters of a live citizen, wherever it is kept, both nullptr if there is no such citizen
+    struct CSums{
+        int * income = nullptr;
+        int * expenses = nullptr;
+        CitizenRef ref = 0;
+    };
+    struct RefKeyOf{
+        const CCitizenStore * store;
+        const CRegisterImage * image;
+        NameKey operator()(CitizenRef ref) const {
+            return ref & 1 ? image->nameKey(image->row(ref >> 1)) : store->nameKey(ref >> 1);
+        }
+    };
+    using CReports = CReportIndex<RefKeyOf>;
+    static constexpr size_t CSV_CHUNK = 1 << 14;        //citizens formatted by one thread at a time
+
+    explicit CTaxRegister (const std::string & path) : image(path){}
+
+    Handle findByName (string_view name, string_view addr) const {
+        return dataByNames.find({name, addr});
+    }
+    CSums sumsByName (string_view name, string_view addr){
+        Handle citizen = findByName(name, addr);
+        if(citizen != CCitizenStore::NONE) return {&citizens.income(citizen), &citizens.expenses(citizen), refOf(citizen)};
+        if(CRegisterImage::Row * row = image.findByName({name, addr})) return {&row->income, &row->expenses, refOf(*row)};
+        return {};
+    }
+    CSums sumsByAccount (string_view account, uint32_t h){
+        if(auto citizen = dataByAccounts.find(account, h)) return {&citizens.income(*citizen), &citizens.expenses(*citizen), refOf(*citizen)};
+        if(CRegisterImage::Row * row = image.findByAccount(account)) return {&row->income, &row->expenses, refOf(*row)};
+        return {};
+    }
+    CSums sumsByAccount (string_view account){
+        return sumsByAccount(account, CAccountIndex::hashOf(account));
+    }
+    //Keeps the report index current after the counters in sums changed
+    void changed (const CSums & sums){
+        if(reports) reports->update(sums.ref, *sums.income, *sums.expenses);
+    }
+
+    CitizenRef refOf (Handle citizen) const {
+        return citizen << 1;
+    }
+    CitizenRef refOf (const CRegisterImage::Row & row) const {
+        return image.indexOf(row) << 1 | 1;
+    }
+    NameKey keyOf (CitizenRef ref) const {
+        return RefKeyOf{&citizens, &image}(ref);
+    }
+    int incomeOf (CitizenRef ref) const {
+        return ref & 1 ? image.row(ref >> 1).income : citizens.income(ref >> 1);
+    }
+
+    //Calls visit(ref, key, account, income, expenses) for every live citizen of both layers in name order
+    template <typename F>
+    void forEachLive (F && visit) const {
+        CSnapshotCursor<CNameIndex> changes = dataByNames.snapshot();
+        CRegisterImage::CCursor base = image.begin(changes.epoch());
+        while(base.get() || changes.get() != CCitizenStore::NONE){
+            const CRegisterImage::Row * row = base.get();
+            if(row && (changes.get() == CCitizenStore::NONE || image.nameKey(*row) < citizens.nameKey(changes.get()))){
+                visit(refOf(*row), image.nameKey(*row), image.text(row->account), row->income, row->expenses);
+                base.next();
+            } else {
+                Handle citizen = changes.get();
+                visit(refOf(citizen), citizens.nameKey(citizen), citizens.account(citizen), citizens.income(citizen), citizens.expenses(citizen));
+                changes.next();
+            }
+        }
+    }
+
+    //Built by the first report, from then on every change keeps it current
+    const CReports & reportIndex () const {
+        if(!reports){
+            vector<CReports::Item> items;
+            forEachLive([&items](CitizenRef ref, const NameKey &, string_view, int income, int expenses){
+                items.push_back({ref, income, expenses});
+            });
+            reports = make_unique<CReports>(RefKeyOf{&citizens, &image});
+            reports->assign(items);
+        }
+        return *reports;
+    }
+
+    CRegisterImage image;
+    CCitizenStore citizens;
+    CNameVersions dataByNames{citizens, true};
+    CAccountIndex dataByAccounts{AccountOf{&citizens}};
+    mutable unique_ptr<CReports> reports;
+};
+
+//Append-only log of register mutations with group commit. append only queues a record, sync makes it
+//durable: the first waiting thread writes everything queued so far with a single fdatasync, the threads
+//that arrive meanwhile wait for it and usually find their records already covered.
+//A record is a fixed 24-byte header followed by the bytes of its strings.
+class CTaxLog
+{
+    struct Header{
+        uint32_t checksum;               //of everything after this field
+        uint8_t kind;
+        uint8_t padding[3];
+        int32_t amount;
+        uint32_t nameSize;
+        uint32_t addressSize;
+        uint32_t accountSize;
+    };
+public:
+    enum class EKind : uint8_t { Birth, Death, IncomeByAccount, IncomeByName, ExpenseByAccount, ExpenseByName };
+    struct Record{
+        EKind kind;
+        string_view name = {};
+        string_view address = {};
+        string_view account = {};
+        int amount = 0;
+    };
+
+    //Appends go after the last complete record whether or not the log is replayed
+    explicit CTaxLog(const string & path) : path(path){
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(fd < 0) throw runtime_error("Cannot open tax log " + path);
+        try{
+            end = scan([](const Record &){});
+        }catch(...){
+            close(fd);
+            throw;
+        }
+    }
+    CTaxLog(const CTaxLog &) = delete;
+    CTaxLog & operator=(const CTaxLog &) = delete;
+    ~CTaxLog(){
+        close(fd);
+    }
+
+    //Calls apply for every complete record in the file
+    template <typename F>
+    void replay(F && apply){
+        scan(apply);
+    }
+
+    //Queues a record, returns the number to wait for with sync
+    uint64_t append(const Record & record){
+        Header header{};
+        header.kind = uint8_t(record.kind);
+        header.amount = record.amount;
+        header.nameSize = record.name.size();
+        header.addressSize = record.address.size();
+        header.accountSize = record.account.size();
+
+        lock_guard lock(mtx);
+        size_t start = pending.size();
+        pending.resize(start + sizeof(Header) + record.name.size() + record.address.size() + record.account.size());
+        char * out = pending.data() + start;
+        memcpy(out, &header, sizeof(header));
+        char * text = out + sizeof(Header);
+        text = copy(record.name.begin(), record.name.end(), text);
+        text = copy(record.address.begin(), record.address.end(), text);
+        copy(record.account.begin(), record.account.end(), text);
+        header.checksum = checksumOf(out, pending.size() - start);
+        memcpy(out, &header.checksum, sizeof(header.checksum));
+        return ++appended;
+    }
+
+    //Returns once the record numbered lsn and all before it are on disk
+    void sync(uint64_t lsn){
+        unique_lock lock(mtx);
+        while(durable < lsn){
+            if(broken) throw runtime_error("Cannot write tax log " + path);
+            if(flushing){
+                flushed.wait(lock);
+                continue;
+            }
+            //This thread leads the next group, everything queued so far goes out together
+            flushing = true;
+            vector<char> group;
+            group.swap(pending);
+            uint64_t upTo = appended;
+            size_t offset = end;
+            lock.unlock();
+
+            bool ok = true;
+            for(size_t done = 0; ok && done < group.size();){
+                ssize_t written = pwrite(fd, group.data() + done, group.size() - done, offset + done);
+                ok = written > 0;
+                if(ok) done += written;
+            }
+            ok = ok && fdatasync(fd) == 0;
+
+            lock.lock();
+            flushing = false;
+            flushed.notify_all();
+            //The group may be partly written, no later record can be made durable after it
+            broken = !ok;
+            if(broken) throw runtime_error("Cannot write tax log " + path);
+            end += group.size();
+            durable = upTo;
+            syncCount++;
+            //Hand the buffer back, so its capacity is reused by the next group
+            if(pending.empty()){
+                group.clear();
+                pending.swap(group);
+            }
+        }
+    }
+
+    //Number of fdatasync calls so far
+    size_t syncs() const {
+        lock_guard lock(mtx);
+        return syncCount;
+    }
+
+private:
+    //Calls apply for every complete record, cuts a torn record off the end and returns where the records end
+    template <typename F>
+    size_t scan(F && apply){
+        vector<char> data;
+        char chunk[64 * 1024];
+        for(ssize_t got; (got = pread(fd, chunk, sizeof(chunk), data.size())) > 0;) data.insert(data.end(), chunk, chunk + got);
+
+        size_t pos = 0;
+        while(data.size() - pos >= sizeof(Header)){
+            Header header;
+            memcpy(&header, data.data() + pos, sizeof(header));
+            size_t size = sizeof(Header) + size_t(header.nameSize) + header.addressSize + header.accountSize;
+            if(data.size() - pos < size || header.kind > uint8_t(EKind::ExpenseByName)) break;
+            if(header.checksum != checksumOf(data.data() + pos, size)) break;
+
+            const char * text = data.data() + pos + sizeof(Header);
+            Record record{EKind(header.kind), {text, header.nameSize}, {text + header.nameSize, header.addressSize},
+                          {text + header.nameSize + header.addressSize, header.accountSize}, header.amount};
+            apply(record);
+            pos += size;
+        }
+        if(pos != data.size() && ftruncate(fd, pos) != 0) throw runtime_error("Cannot truncate tax log " + path);
+        return pos;
+    }
+
+    //FNV-1a over the record without its checksum field
+    static uint32_t checksumOf(const char * record, size_t size){
+        uint32_t h = 2166136261u;
+        for(size_t i = sizeof(uint32_t); i < size; i++) h = (h ^ uint8_t(record[i])) * 16777619u;
+        return h;
+    }
+
+    string path;
+    int fd = -1;
+    mutable mutex mtx;
+    condition_variable flushed;
+    vector<char> pending;
+    uint64_t appended = 0;
+    uint64_t durable = 0;
+    size_t end = 0;
+    bool flushing = false;
+    bool broken = false;
+    size_t syncCount = 0;
+};
+
+//Merges per-shard snapshots, a shard is locked only while its own cursor moves
+class CShardedIterator
+{
+public:
+    bool atEnd () const{
+        return current == parts.size();
+    }
+    void next (){
+        if(atEnd()) return;
+        {
+            shared_lock lock(*parts[current].lock);
+            parts[current].cursor.next();
+        }
+        pickSmallest();
+    }
+    const std::string & name () const {
+        return nameBuf;
+    }
+
+    const std::string & addr () const {
+        return addrBuf;
+    }
+
+    const std::string & account () const {
+        return accountBuf;
+    }
+private:
+    friend class CConcurrentTaxRegister;
+    struct Part{
+        shared_mutex * lock;
+        CSnapshotCursor<CNameIndex> cursor;
+    };
+    CShardedIterator() = default;
+
+    //Shard counts are small enough for a linear pick, names of visible citizens never change
+    void pickSmallest(){
+        current = parts.size();
+        for(size_t i = 0; i < parts.size(); i++){
+            Handle citizen = parts[i].cursor.get();
+            if(citizen == CCitizenStore::NONE) continue;
+            const CCitizenStore & citizens = parts[i].cursor.store();
+            if(current == parts.size() || citizens.nameKey(citizen) < citizens.nameKey(parts[current].cursor.get())) current = i;
+        }
+        if(atEnd()){
+            nameBuf.clear();
+            addrBuf.clear();
+            accountBuf.clear();
+            return;
+        }
+        const CSnapshotCursor<CNameIndex> & cursor = parts[current].cursor;
+        nameBuf.assign(cursor.store().name(cursor.get()));
+        addrBuf.assign(cursor.store().address(cursor.get()));
+        accountBuf.assign(cursor.store().account(cursor.get()));
+    }
+
+    vector<Part> parts;
+    size_t current = 0;
+    string nameBuf;
+    string addrBuf;
+    string accountBuf;
+};
+
+//Register for many threads, split into shards. A citizen's account is indexed in the shard picked by
+//the account hash and its name in the shard picked by the name hash, so every lookup visits one shard.
+//All shards share one citizen store, whose rows stay in place while other threads add new ones.
+//income/expense hold their shard lock shared and add atomically, so they run in parallel even inside one shard.
+//birth/death lock the (at most two) shards they change, in shard order.
+//A listing works on per-shard snapshots, so births and deaths go on while it runs.
+//With a log, every successful mutation is logged while its shard locks are held, so conflicting mutations
+//reach the log in the order they were applied, and it returns only after the log is synced.
+class CConcurrentTaxRegister
+{
+public:
+    explicit CConcurrentTaxRegister (size_t shardCount = 16){
+        for(size_t i = 0; i < shardCount; i++) shards.push_back(make_unique<Shard>(citizens));
+    }
+    CConcurrentTaxRegister(const CConcurrentTaxRegister &) = delete;
+    CConcurrentTaxRegister & operator=(const CConcurrentTaxRegister &) = delete;
+    //Replays the log at logPath, then logs every further mutation to it
+    CConcurrentTaxRegister (size_t shardCount, const std::string & logPath) : CConcurrentTaxRegister(shardCount){
+        auto replayed = make_unique<CTaxLog>(logPath);
+        replayed->replay([this](const CTaxLog::Record & r){
+            string name(r.name), addr(r.address), account(r.account);
+            switch(r.kind){
+                case CTaxLog::EKind::Birth: birth(name, addr, account); break;
+                case CTaxLog::EKind::Death: death(name, addr); break;
+                case CTaxLog::EKind::IncomeByAccount: income(account, r.amount); break;
+                case CTaxLog::EKind::IncomeByName: income(name, addr, r.amount); break;
+                case CTaxLog::EKind::ExpenseByAccount: expense(account, r.amount); break;
+                case CTaxLog::EKind::ExpenseByName: expense(name, addr, r.amount); break;
+            }
+        });
+        log = std::move(replayed);
     }
+
+    bool birth (const std::string & name, const std::string & addr, const std::string & account){
+        uint64_t lsn;
+        {
+            Shard & nameShard = shardOfName(name, addr);
+            Shard & accountShard = shardOfAccount(account);
+            auto locks = lockPair(nameShard, accountShard);
+            if(nameShard.names.find({name, addr}) != CCitizenStore::NONE || accountShard.accounts.find(account)) return false;
+
+            Handle newCitizen = citizens.add(name, addr, account);
+            accountShard.accounts.insert(newCitizen);
+            nameShard.names.insert(newCitizen);
+            lsn = logged({CTaxLog::EKind::Birth, name, addr, account});
+        }
+        return synced(lsn);
+    }
+    bool death (const std::string & name, const std::string & addr){
+        Shard & nameShard = shardOfName(name, addr);
+        uint64_t lsn;
+        //Each attempt holds nothing when it starts over: not the shard locks, not the citizen's strings
+        for(;;){
+            string account;
+            {
+                shared_lock lock(nameShard.lock);
+                Handle citizen = nameShard.names.find({name, addr});
+                if(citizen == CCitizenStore::NONE) return false;
+                account = citizens.account(citizen);
+            }
+
+            //Both locks are taken in shard order, the citizen may have changed in between
+            Shard & accountShard = shardOfAccount(account);
+            auto locks = lockPair(nameShard, accountShard);
+            Handle citizen = nameShard.names.find({name, addr});
+            if(citizen == CCitizenStore::NONE) return false;
+            if(citizens.account(citizen) != account) continue;
+
+            accountShard.accounts.erase(account);
+            nameShard.names.remove(citizen);
+            lsn = logged({CTaxLog::EKind::Death, name, addr});
+            break;
+        }
+        return synced(lsn);
+    }
+    bool income (const std::string & account, int amount){
+        return addByAccount(account, amount, &CCitizenStore::income, CTaxLog::EKind::IncomeByAccount);
+    }
+    bool income (const std::string & name, const std::string & addr, int amount){
+        return addByName(name, addr, amount, &CCitizenStore::income, CTaxLog::EKind::IncomeByName);
+    }
+    bool expense (const std::string & account, int amount){
+        return addByAccount(account, amount, &CCitizenStore::expenses, CTaxLog::EKind::ExpenseByAccount);
+    }
+    bool expense (const std::string & name, const std::string & addr, int amount){
+        return addByName(name, addr, amount, &CCitizenStore::expenses, CTaxLog::EKind::ExpenseByName);
+    }
+    bool audit (const std::string & name, const std::string & addr,
+                std::string & account, int & sumIncome, int & sumExpense) const {
+        const Shard & shard = shardOfName(name, addr);
+        shared_lock lock(shard.lock);
+        Handle citizen = shard.names.find({name, addr});
+        if(citizen == CCitizenStore::NONE) return false;
+
+        account = citizens.account(citizen);
+        sumIncome = atomic_ref<int>(citizens.income(citizen)).load(memory_order_relaxed);
+        sumExpense = atomic_ref<int>(citizens.expenses(citizen)).load(memory_order_relaxed);
+        return true;
+    }
+    CShardedIterator listByName () const{
+        //All shards are held at once, so the snapshots form one consistent cut
+        vector<shared_lock<shared_mutex>> locks;
+        for(const auto & shard : shards) locks.emplace_back(shard->lock);
+
+        CShardedIterator it;
+        for(const auto & shard : shards) it.parts.push_back({&shard->lock, shard->names.snapshot()});
+        it.pickSmallest();
+        return it;
+    }
+private:
+    struct alignas(64) Shard{
+        explicit Shard(CCitizenStore & citizens) : names(citizens), accounts(AccountOf{&citizens}){}
+        mutable shared_mutex lock;
+        CNameVersions names;
+        CAccountIndex accounts;
+    };
+    using Column = int & (CCitizenStore::*)(Handle);
+
+    Shard & shardOfAccount (string_view account){
+        return *shards[CAccountIndex::hashOf(account) % shards.size()];
+    }
+    const Shard & shardOfName (string_view name, string_view addr) const {
+        uint64_t h = uint64_t(CAccountIndex::hashOf(name)) * 31 + CAccountIndex::hashOf(addr);
+        return *shards[h % shards.size()];
+    }
+    Shard & shardOfName (string_view name, string_view addr){
+        return const_cast<Shard &>(as_const(*this).shardOfName(name, addr));
+    }
+
+    pair<unique_lock<shared_mutex>, unique_lock<shared_mutex>> lockPair (Shard & a, Shard & b){
+        if(&a == &b) return {unique_lock(a.lock), unique_lock<shared_mutex>()};
+        if(&b < &a) return {unique_lock(b.lock), unique_lock(a.lock)};
+        return {unique_lock(a.lock), unique_lock(b.lock)};
+    }
+
+    bool addByAccount (string_view account, int amount, Column column, CTaxLog::EKind kind){
+        uint64_t lsn;
+        {
+            Shard & shard = shardOfAccount(account);
+            shared_lock lock(shard.lock);
+            auto citizen = shard.accounts.find(account);
+            if(!citizen) return false;
+
+            atomic_ref<int>((citizens.*column)(*citizen)).fetch_add(amount, memory_order_relaxed);
+            lsn = logged({kind, {}, {}, account, amount});
+        }
+        return synced(lsn);
+    }
+    bool addByName (string_view name, string_view addr, int amount, Column column, CTaxLog::EKind kind){
+        uint64_t lsn;
+        {
+            Shard & shard = shardOfName(name, addr);
+            shared_lock lock(shard.lock);
+            Handle citizen = shard.names.find({name, addr});
+            if(citizen == CCitizenStore::NONE) return false;
+
+            atomic_ref<int>((citizens.*column)(citizen)).fetch_add(amount, memory_order_relaxed);
+            lsn = logged({kind, name, addr, {}, amount});
+        }
+        return synced(lsn);
+    }
+
+    uint64_t logged (const CTaxLog::Record & record){
+        return log ? log->append(record) : 0;
+    }
+    //Waits outside the shard locks, so other mutations can join the same group meanwhile
+    bool synced (uint64_t lsn){
+        if(log) log->sync(lsn);
+        return true;
+    }
+
+    mutable CCitizenStore citizens;
+    vector<unique_ptr<Shard>> shards;
+    unique_ptr<CTaxLog> log;
 };
 
-class CIterator
+#ifndef __PROGTEST__
+//Counts every global allocation, so tests can check that a code path does not allocate.
+//The deletes stay out of line: GCC warns when it sees an inlined free() paired with this operator new.
+atomic<size_t> allocationCount = 0;
+
+void * operator new (size_t size)
 {
-public:
-    CIterator(const vector<shared_ptr<Citizen>> & data) : data(data){}
-    bool atEnd () const{
-        if(index >= data.size()) return true;
-        return false;
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if(void * ptr = malloc(size ? size : 1)) return ptr;
+    throw bad_alloc();
+}
+[[gnu::noinline]] void operator delete (void * ptr) noexcept
+{
+    free(ptr);
+}
+[[gnu::noinline]] void operator delete (void * ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+//Births and deaths of a fixed batch on top of registers of growing size, ops/s should stay flat
+void benchmarkBirthDeath ()
+{
+    const size_t batch = 100'000;
+    mt19937 rng(42);
+    for(size_t population : {10'000u, 100'000u, 1'000'000u, 4'000'000u}){
+        vector<size_t> ids(population + batch);
+        for(size_t i = 0; i < ids.size(); i++) ids[i] = i;
+        shuffle(ids.begin(), ids.end(), rng);
+
+        CTaxRegister reg;
+        for(size_t i = 0; i < population; i++){
+            string id = to_string(ids[i]);
+            reg.birth("Citizen " + id, "Street " + to_string(ids[i] % 1000), "ACC" + id);
+        }
+
+        auto start = chrono::steady_clock::now();
+        for(size_t i = population; i < ids.size(); i++){
+            string id = to_string(ids[i]);
+            reg.birth("Citizen " + id, "Street " + to_string(ids[i] % 1000), "ACC" + id);
+        }
+        for(size_t i = population; i < ids.size(); i++){
+            reg.death("Citizen " + to_string(ids[i]), "Street " + to_string(ids[i] % 1000));
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "population " << setw(8) << population << ": "
+             << fixed << setprecision(0) << (2 * batch) / seconds << " birth+death ops/s" << endl;
     }
-    void next (){
-        if(index < data.size()) index++;
+}
+
+//Cold start of a whole population, one birth at a time against a single bulkBirth
+void benchmarkBulkLoad ()
+{
+    const size_t population = 2'000'000;
+    vector<tuple<string, string, string>> records;
+    records.reserve(population);
+    for(size_t i = 0; i < population; i++){
+        string id = to_string(i * 7919 % population);
+        records.emplace_back("Citizen " + id, "Street " + id.substr(0, 3), "ACC" + id);
     }
-    const std::string & name () const {
-        static const string emptyStr;
-        if(atEnd()) return emptyStr;
-        return data[index]->name;
+
+    auto start = chrono::steady_clock::now();
+    CTaxRegister single;
+    for(const auto & [name, addr, account] : records) single.birth(name, addr, account);
+    double singleSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    CTaxRegister bulk;
+    bulk.bulkBirth(records);
+    double bulkSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "load " << population << " citizens: birth " << fixed << setprecision(2) << singleSeconds
+         << " s, bulkBirth " << bulkSeconds << " s" << endl;
+}
+
+//Bank feed batches of 100k events, one income/expense call per event against applyBatch
+void benchmarkBatch ()
+{
+    const size_t population = 1'000'000, batch = 100'000;
+    vector<tuple<string, string, string>> records;
+    for(size_t i = 0; i < population; i++){
+        string id = to_string(i);
+        records.emplace_back("Citizen " + id, "Street " + id.substr(0, 3), "ACC" + id);
     }
+    CTaxRegister reg;
+    reg.bulkBirth(records);
 
-    const std::string & addr () const {
-        static const string emptyStr;
-        if(atEnd()) return emptyStr;
-        return data[index]->address;
+    mt19937 rng(3);
+    vector<string> accounts(batch);
+    vector<Transaction> transactions(batch);
+    for(size_t i = 0; i < batch; i++){
+        //Skewed towards a smaller set of busy accounts
+        accounts[i] = "ACC" + to_string(rng() % (rng() % 2 ? 1000 : population));
+        transactions[i] = {accounts[i], int(rng() % 1000), rng() % 2 ? Transaction::EKind::Income : Transaction::EKind::Expense};
     }
 
-    const std::string & account () const {
-        static const string emptyStr;
-        if(atEnd()) return emptyStr;
-        return data[index]->account;
+    auto start = chrono::steady_clock::now();
+    for(const Transaction & t : transactions){
+        string account(t.account);
+        if(t.kind == Transaction::EKind::Income) reg.income(account, t.amount);
+        else reg.expense(account, t.amount);
+    }
+    double singleSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    reg.applyBatch(transactions);
+    double batchSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "batch of " << batch << " transactions: single calls " << fixed << setprecision(0) << batch / singleSeconds
+         << " ops/s, applyBatch " << batch / batchSeconds << " ops/s" << endl;
+}
+
+//Heap bytes per citizen with names and addresses repeating as in a real population
+void benchmarkMemory ()
+{
+    const size_t population = 1'000'000;
+    static const char * const firstNames[] = {"Jan", "Petr", "Pavel", "Jana", "Eva", "Marie", "Tomas", "Lucie", "Martin", "Anna"};
+    size_t before = mallinfo2().uordblks;
+    {
+        CTaxRegister reg;
+        for(size_t i = 0; i < population; i++){
+            //Name and address repeat with coprime periods, so every pair stays unique
+            size_t person = i % 100'003, street = i % 20'011;
+            string name = string(firstNames[person % 10]) + " Novak " + to_string(person / 10);
+            string addr = "Long Street " + to_string(street / 20) + "/" + to_string(street % 20) + ", Prague";
+            reg.birth(name, addr, "CZ6508000000" + to_string(1'000'000'000 + i));
+        }
+        size_t after = mallinfo2().uordblks;
+        cout << "memory: " << fixed << setprecision(1) << double(after - before) / population << " bytes per citizen" << endl;
+    }
+}
+
+//Mixed income/audit traffic from many threads, one global mutex around CTaxRegister against the sharded register
+void benchmarkConcurrent ()
+{
+    const size_t population = 200'000, opsPerThread = 400'000;
+    CTaxRegister single;
+    CConcurrentTaxRegister sharded;
+    mutex globalLock;
+    for(size_t i = 0; i < population; i++){
+        string id = to_string(i);
+        single.birth("Citizen " + id, "Street " + id.substr(0, 3), "ACC" + id);
+        sharded.birth("Citizen " + id, "Street " + id.substr(0, 3), "ACC" + id);
+    }
+
+    auto run = [&](size_t threadCount, auto && work){
+        auto start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for(size_t t = 0; t < threadCount; t++){
+            threads.emplace_back([&work, t]{
+                mt19937 rng(t);
+                string acct;
+                int sumIncome, sumExpense;
+                for(size_t i = 0; i < opsPerThread; i++){
+                    string id = to_string(rng() % population);
+                    work(rng() % 5 == 0, id, acct, sumIncome, sumExpense);
+                }
+            });
+        }
+        for(thread & th : threads) th.join();
+        return threadCount * opsPerThread / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+
+    for(size_t threadCount : {1u, 2u, 4u, 8u}){
+        double locked = run(threadCount, [&](bool isAudit, const string & id, string & acct, int & sumIncome, int & sumExpense){
+            lock_guard lock(globalLock);
+            if(isAudit) single.audit("Citizen " + id, "Street " + id.substr(0, 3), acct, sumIncome, sumExpense);
+            else single.income("ACC" + id, 1);
+        });
+        double concurrent = run(threadCount, [&](bool isAudit, const string & id, string & acct, int & sumIncome, int & sumExpense){
+            if(isAudit) sharded.audit("Citizen " + id, "Street " + id.substr(0, 3), acct, sumIncome, sumExpense);
+            else sharded.income("ACC" + id, 1);
+        });
+        cout << threadCount << " threads: global mutex " << fixed << setprecision(0) << locked
+             << " ops/s, sharded " << concurrent << " ops/s" << endl;
+    }
+}
+
+//Restart of a saved register, open against rebuilding it with bulkBirth
+void benchmarkImage ()
+{
+    const size_t population = 2'000'000;
+    const string path = "bench_register.img";
+    vector<tuple<string, string, string>> records;
+    records.reserve(population);
+    for(size_t i = 0; i < population; i++){
+        string id = to_string(i * 7919 % population);
+        records.emplace_back("Citizen " + id, "Street " + id.substr(0, 3), "ACC" + id);
+    }
+
+    auto start = chrono::steady_clock::now();
+    {
+        CTaxRegister reg;
+        reg.bulkBirth(records);
+        double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        reg.save(path);
+        cout << "restart of " << population << " citizens: bulkBirth " << fixed << setprecision(2) << buildSeconds << " s";
+    }
+
+    start = chrono::steady_clock::now();
+    CTaxRegister reg = CTaxRegister::open(path);
+    string acct;
+    int sumIncome, sumExpense;
+    reg.audit("Citizen 12345", "Street 123", acct, sumIncome, sumExpense);
+    double openSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << ", open + first audit " << setprecision(2) << openSeconds * 1000 << " ms" << endl;
+    remove(path.c_str());
+}
+
+//Durable log appends with one sync per 1, 64 and 4096 records, then durable incomes from many threads sharing syncs
+void benchmarkLog ()
+{
+    const string path = "bench_tax.log";
+    for(size_t batch : {1u, 64u, 4096u}){
+        remove(path.c_str());
+        size_t records = batch == 1 ? 2'000 : 200'000;
+        CTaxLog log(path);
+        auto start = chrono::steady_clock::now();
+        for(size_t i = 0; i < records; i++){
+            string id = to_string(i);
+            uint64_t lsn = log.append({CTaxLog::EKind::IncomeByAccount, {}, {}, "ACC" + id, 100});
+            if((i + 1) % batch == 0 || i + 1 == records) log.sync(lsn);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "log, batch " << setw(4) << batch << ": " << fixed << setprecision(0) << records / seconds << " records/s" << endl;
+    }
+
+    remove(path.c_str());
+    const size_t population = 10'000, opsPerThread = 2'000;
+    CConcurrentTaxRegister reg(16, path);
+    for(size_t i = 0; i < population; i++){
+        string id = to_string(i);
+        reg.birth("Citizen " + id, "Street " + id.substr(0, 3), "ACC" + id);
+    }
+    for(size_t threadCount : {1u, 8u, 64u}){
+        auto start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for(size_t t = 0; t < threadCount; t++){
+            threads.emplace_back([&reg, t]{
+                mt19937 rng(t);
+                for(size_t i = 0; i < opsPerThread; i++) reg.income("ACC" + to_string(rng() % population), 1);
+            });
+        }
+        for(thread & th : threads) th.join();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "logged register, " << threadCount << " threads: " << fixed << setprecision(0)
+             << threadCount * opsPerThread / seconds << " durable ops/s" << endl;
+    }
+    remove(path.c_str());
+}
+
+//A small slice of a large register, range listing against filtering the full listing
+void benchmarkRanges ()
+{
+    const size_t population = 1'000'000;
+    vector<tuple<string, string, string>> records;
+    for(size_t i = 0; i < population; i++){
+        string id = to_string(i);
+        records.emplace_back("Citizen " + id, "Street " + id.substr(0, 3), "ACC" + id);
+    }
+    CTaxRegister reg;
+    reg.bulkBirth(records);
+
+    auto start = chrono::steady_clock::now();
+    size_t scanned = 0;
+    for(CIterator it = reg.listByName(); !it.atEnd(); it.next()) scanned += it.name().starts_with("Citizen 12345");
+    double scanSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    size_t ranged = 0;
+    for(CIterator it = reg.listByNamePrefix("Citizen 12345"); !it.atEnd(); it.next()) ranged++;
+    double rangeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "prefix of " << ranged << " citizens out of " << population << ": full scan " << fixed << setprecision(2)
+         << scanSeconds * 1000 << " ms, listByNamePrefix " << rangeSeconds * 1000 << " ms" << endl;
+    assert(scanned == ranged);
+}
+
+//Range totals from the report index against summing a range listing, and what keeping the index costs income
+void benchmarkReports ()
+{
+    const size_t population = 1'000'000, updates = 1'000'000;
+    vector<tuple<string, string, string>> records;
+    for(size_t i = 0; i < population; i++){
+        string id = to_string(i);
+        records.emplace_back("Citizen " + id, "Street " + id.substr(0, 3), "ACC" + id);
+    }
+    CTaxRegister reg;
+    reg.bulkBirth(records);
+    mt19937 rng(9);
+    auto incomes = [&]{
+        auto start = chrono::steady_clock::now();
+        for(size_t i = 0; i < updates; i++) reg.income(get<2>(records[rng() % population]), 10);
+        return updates / chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    double plain = incomes();
+
+    auto start = chrono::steady_clock::now();
+    reg.summarize();
+    double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double reported = incomes();
+
+    start = chrono::steady_clock::now();
+    long long listed = 0;
+    string acct;
+    int sumIncome, sumExpense;
+    for(CIterator it = reg.listByName("Citizen 2", "Citizen 4"); !it.atEnd(); it.next()){
+        reg.audit(it.name(), it.addr(), acct, sumIncome, sumExpense);
+        listed += sumIncome;
+    }
+    double listSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    CTaxSummary summary = reg.summarize("Citizen 2", "Citizen 4");
+    double summarySeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    assert(summary.income == listed);
+
+    cout << "report index over " << population << " citizens: built in " << fixed << setprecision(2) << buildSeconds
+         << " s, range total " << summarySeconds * 1e6 << " us against " << listSeconds * 1e3 << " ms by listing, income "
+         << setprecision(0) << plain << " ops/s before, " << reported << " ops/s with the index" << endl;
+}
+
+//Year-end cleanup, a third of the population dies at once
+void benchmarkMassDeath ()
+{
+    const size_t population = 1'000'000;
+    vector<tuple<string, string, string>> records;
+    for(size_t i = 0; i < population; i++){
+        string id = to_string(i);
+        records.emplace_back("Citizen " + id, "Street " + id.substr(0, 3), "ACC" + id);
+    }
+    for(double ratio : {0.25, 1e9}){
+        CTaxRegister reg;
+        reg.bulkBirth(records);
+        reg.setCompactionRatio(ratio);
+        auto start = chrono::steady_clock::now();
+        for(size_t i = 0; i < population; i += 3) reg.death(get<0>(records[i]), get<1>(records[i]));
+        reg.compact();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "death of " << (population + 2) / 3 << " citizens, " << (ratio < 1 ? "compaction at 25 %" : "one compaction at the end")
+             << ": " << fixed << setprecision(2) << seconds << " s" << endl;
+    }
+}
+
+//A full-population tax pass, scalar kernel against the engine on one and on all cores,
+//then computeTaxes of a register, which gathers the counters before the engine runs
+void benchmarkTaxes ()
+{
+    const size_t population = 20'000'000;
+    const vector<CTaxBracket> brackets { { 0, 0 }, { 10000, 1500 }, { 50000, 2300 }, { 1000000, 4500 } };
+    CTaxEngine engine ( brackets );
+    vector<int> incomes ( population ), expenses ( population );
+    mt19937 rng(14);
+    for(size_t i = 0; i < population; i++){
+        incomes[i] = int(rng() % 2000000);
+        expenses[i] = int(rng() % 100000);
+    }
+    vector<long long> taxes(population);
+    auto measure = [&](auto && pass){
+        auto start = chrono::steady_clock::now();
+        pass();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return population * (2 * sizeof(int) + sizeof(long long)) / seconds / 1e9;
+    };
+    double scalar = measure([&]{ for(size_t i = 0; i < population; i++) taxes[i] = engine.tax(incomes[i], expenses[i]); });
+    double single = measure([&]{ engine.compute(incomes, expenses, taxes, 1); });
+    double parallel = measure([&]{ engine.compute(incomes, expenses, taxes); });
+    cout << "tax pass over " << population << " citizens: scalar " << fixed << setprecision(2) << scalar << " GB/s, engine "
+         << single << " GB/s on one thread, " << parallel << " GB/s on " << thread::hardware_concurrency() << endl;
+
+    const size_t citizens = 2'000'000;
+    vector<tuple<string, string, string>> records;
+    records.reserve(citizens);
+    for(size_t i = 0; i < citizens; i++){
+        string id = to_string(i);
+        records.emplace_back("Citizen " + id, "Street " + id.substr(0, 3), "ACC" + id);
+    }
+    CTaxRegister reg;
+    reg.bulkBirth(records);
+    for(size_t i = 0; i < citizens; i++){
+        reg.income(get<2>(records[i]), incomes[i]);
+        reg.expense(get<2>(records[i]), expenses[i]);
+    }
+    auto start = chrono::steady_clock::now();
+    reg.computeTaxes(brackets, taxes);
+    double gathered = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    start = chrono::steady_clock::now();
+    engine.compute(span(incomes).first(citizens), span(expenses).first(citizens), span(taxes).first(citizens));
+    double kernel = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "computeTaxes of " << citizens << " citizens: " << fixed << setprecision(2)
+         << citizens * (2 * sizeof(int) + sizeof(long long)) / gathered / 1e9 << " GB/s with the gather, "
+         << setprecision(1) << 100 * kernel / gathered << " % of it in the engine" << endl;
+}
+
+//Migration dump of a large register, export and import throughput
+void benchmarkCsv ()
+{
+    const size_t population = 2'000'000;
+    const string path = "benchmarkCsv.csv";
+    vector<tuple<string, string, string>> records;
+    for(size_t i = 0; i < population; i++){
+        string id = to_string(i);
+        records.emplace_back("Citizen " + id, "Street " + id.substr(0, 3) + ", Town", "ACC" + id);
+    }
+    CTaxRegister reg;
+    reg.bulkBirth(records);
+    for(size_t i = 0; i < population; i += 2) reg.income(get<2>(records[i]), int(i));
+
+    auto start = chrono::steady_clock::now();
+    reg.exportCsv(path);
+    double exportSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    struct stat info;
+    stat(path.c_str(), &info);
+    start = chrono::steady_clock::now();
+    CTaxRegister copy;
+    copy.importCsv(path);
+    double importSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    double megabytes = info.st_size / 1e6;
+    cout << "CSV dump of " << population << " citizens, " << fixed << setprecision(0) << megabytes << " MB: export "
+         << megabytes / exportSeconds << " MB/s, import " << megabytes / importSeconds << " MB/s" << endl;
+    remove(path.c_str());
+}
+
+//Deterministic synthetic population: first names, surnames and streets follow Zipf distributions, so a few
+//of them are very common, as in a real register. Citizen i is generated on demand, so 10^8 of them need no memory.
+class CPopulation
+{
+public:
+    CPopulation()
+        : firstNames(words(2'000, 2)), surnames(words(20'000, 3)), streets(words(5'000, 3)),
+          firstNameOf(firstNames.size(), 1.1), surnameOf(surnames.size(), 1.0), streetOf(streets.size(), 0.9){}
+
+    string name (uint64_t i) const {
+        return firstNames[firstNameOf(mix(i, 1))] + " " + surnames[surnameOf(mix(i, 2))];
+    }
+    //Unique per citizen: the street repeats, the house and the flat are derived from i
+    string address (uint64_t i) const {
+        return streets[streetOf(mix(i, 3))] + " " + to_string(1 + i % 997) + "/" + to_string(i / 997);
+    }
+    //Unique per citizen: a bijection of i onto 40-bit numbers
+    string account (uint64_t i) const {
+        char digits[16];
+        uint64_t number = (i * 0x9E3779B97FULL) & ((1ULL << 40) - 1);
+        return "CZ" + string(digits, to_chars(digits, digits + sizeof(digits), number, 16).ptr);
+    }
+private:
+    struct CZipf{
+        vector<double> cdf;
+        CZipf(size_t count, double exponent) : cdf(count){
+            double sum = 0;
+            for(size_t k = 0; k < count; k++) cdf[k] = sum += 1 / pow(k + 1, exponent);
+            for(double & value : cdf) value /= sum;
+        }
+        size_t operator()(uint64_t random) const {
+            auto it = lower_bound(cdf.begin(), cdf.end(), (random >> 11) * 0x1p-53);
+            return min<size_t>(it - cdf.begin(), cdf.size() - 1);
+        }
+    };
+    static uint64_t mix (uint64_t i, uint64_t stream){
+        uint64_t z = i * 4 + stream + 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    static vector<string> words (size_t count, size_t syllables){
+        static const char * parts[] = {"ja", "na", "mi", "to", "ra", "ke", "lu", "so", "vi", "de", "ma", "ro", "li", "pe", "ka", "zu"};
+        vector<string> result;
+        for(size_t k = 0; k < count; k++){
+            string word;
+            for(size_t n = k, i = 0; i < syllables || n; i++, n /= 16) word += parts[n % 16];
+            word[0] = char(toupper(word[0]));
+            result.push_back(word);
+        }
+        return result;
+    }
+
+    vector<string> firstNames, surnames, streets;
+    CZipf firstNameOf, surnameOf, streetOf;
+};
+
+//Latencies of one kind of operation: ops/s from the summed latencies, percentiles from a bounded sample
+class CLatencies
+{
+public:
+    explicit CLatencies(size_t count) : stride(max<size_t>(1, count / MAX_SAMPLES)){}
+
+    template <typename F>
+    void measure (F && operation){
+        auto start = chrono::steady_clock::now();
+        operation();
+        uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        total += ns;
+        if(count++ % stride == 0) samples.push_back(ns);
+    }
+    void report (const char * operation, size_t population){
+        sort(samples.begin(), samples.end());
+        auto percentile = [this](double p){ return samples.empty() ? 0 : samples[size_t(p * (samples.size() - 1))]; };
+        cout << setw(10) << population << "  " << left << setw(18) << operation << right << fixed << setprecision(0)
+             << setw(12) << count / (total * 1e-9) << " ops/s  p50 " << setw(7) << percentile(0.5)
+             << " ns  p99 " << setw(7) << percentile(0.99) << " ns" << endl;
     }
 private:
-    const vector<shared_ptr<Citizen>> & data;
-    size_t index = 0;
+    static constexpr size_t MAX_SAMPLES = 1'000'000;
+    size_t stride;
+    size_t count = 0;
+    uint64_t total = 0;
+    vector<uint64_t> samples;
 };
 
-bool nameCmp(const shared_ptr<Citizen>& a, const shared_ptr<Citizen> & b){
-    return tie(a->name, a->address) < tie(b->name, b->address);
+//The register's hot paths on synthetic populations of 10^4 up to maxPopulation citizens
+void benchmarkSuite (size_t maxPopulation)
+{
+    CPopulation people;
+    mt19937_64 rng(16);
+    for(size_t population = 10'000; population <= maxPopulation; population *= 10){
+        const size_t operations = min<size_t>(population, 1'000'000);
+        //80 % of the traffic goes to the first 1 % of the citizens
+        auto pick = [&]{ return rng() % 5 ? rng() % max<size_t>(1, population / 100) : rng() % population; };
+        CTaxRegister reg;
+
+        CLatencies births(population);
+        for(size_t i = 0; i < population; i++){
+            string name = people.name(i), address = people.address(i), account = people.account(i);
+            births.measure([&]{ reg.birth(name, address, account); });
+        }
+        births.report("birth", population);
+
+        CLatencies byAccount(operations);
+        for(size_t i = 0; i < operations; i++){
+            string account = people.account(pick());
+            byAccount.measure([&]{ reg.income(account, 100); });
+        }
+        byAccount.report("income by account", population);
+
+        CLatencies byName(operations);
+        for(size_t i = 0; i < operations; i++){
+            size_t citizen = pick();
+            string name = people.name(citizen), address = people.address(citizen);
+            byName.measure([&]{ reg.income(name, address, 100); });
+        }
+        byName.report("income by name", population);
+
+        CLatencies audits(operations);
+        string account;
+        int sumIncome, sumExpense;
+        for(size_t i = 0; i < operations; i++){
+            size_t citizen = pick();
+            string name = people.name(citizen), address = people.address(citizen);
+            audits.measure([&]{ reg.audit(name, address, account, sumIncome, sumExpense); });
+        }
+        audits.report("audit", population);
+
+        CLatencies scan(population);
+        CIterator it = reg.listByName();
+        while(!it.atEnd()) scan.measure([&]{ it.next(); });
+        scan.report("listByName step", population);
+
+        CLatencies deaths(operations);
+        for(size_t i = 0, step = population / operations; i < operations; i++){
+            string name = people.name(i * step), address = people.address(i * step);
+            deaths.measure([&]{ reg.death(name, address); });
+        }
+        deaths.report("death", population);
+
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        cout << setw(10) << population << "  peak RSS " << usage.ru_maxrss / 1024 << " MB" << endl;
+    }
 }
-bool accountCmp(const shared_ptr<Citizen>& a, const shared_ptr<Citizen> & b){
-    return a->account < b->account;
+
+void testTree ()
+{
+    CBPlusTree<int, less<int>, 4> tree;
+    set<int> reference;
+    mt19937 rng(7);
+    for(int i = 0; i < 20000; i++){
+        int value = rng() % 500;
+        if(rng() % 3 == 0){
+            assert ( tree . erase ( value ) == ( reference . erase ( value ) == 1 ) );
+        } else if(!reference.contains(value)){
+            tree . insert ( value );
+            reference . insert ( value );
+        }
+        assert ( tree . size () == reference . size () );
+    }
+    auto it = tree . begin ();
+    for(int value : reference){
+        assert ( ! it . atEnd () && *it == value );
+        ++it;
+    }
+    assert ( it . atEnd () );
+    auto lb = tree . lowerBound ( 250 );
+    assert ( lb . atEnd () ? reference . lower_bound ( 250 ) == reference . end () : *lb == *reference . lower_bound ( 250 ) );
+
+    vector<int> sorted;
+    for(int i = 0; i < 1000; i += 2) sorted . push_back ( i );
+    tree . assign ( vector<int> ( sorted ) );
+    reference . clear ();
+    reference . insert ( sorted . begin (), sorted . end () );
+    for(int i = 0; i < 5000; i++){
+        int value = rng() % 1000;
+        if(rng() % 2 == 0){
+            assert ( tree . erase ( value ) == ( reference . erase ( value ) == 1 ) );
+        } else if(!reference.contains(value)){
+            tree . insert ( value );
+            reference . insert ( value );
+        }
+    }
+    it = tree . begin ();
+    for(int value : reference){
+        assert ( ! it . atEnd () && *it == value );
+        ++it;
+    }
+    assert ( it . atEnd () );
 }
 
-class CTaxRegister
+void testHashIndex ()
 {
-public:
-    bool birth (const std::string & name, const std::string & addr, const std::string & account){
-        auto newCitizen = make_shared<Citizen>(name,addr,account);
+    struct Self{
+        string_view operator()(const string * s) const { return *s; }
+    };
+    vector<string> keys;
+    for(int i = 0; i < 300; i++) keys . push_back ( "key" + to_string(i) );
+    CHashIndex<const string *, Self> index;
+    set<int> reference;
+    mt19937 rng(11);
+    for(int i = 0; i < 20000; i++){
+        int key = rng() % keys . size ();
+        if(rng() % 3 == 0){
+            assert ( index . erase ( keys[key] ) == ( reference . erase ( key ) == 1 ) );
+        } else {
+            assert ( index . insert ( &keys[key] ) == reference . insert ( key ) . second );
+        }
+        assert ( index . size () == reference . size () );
+    }
+    for(size_t key = 0; key < keys . size (); key++){
+        const string * const * found = index . find ( keys[key] );
+        assert ( reference . contains ( key ) ? found && *found == &keys[key] : !found );
+    }
+}
 
-        auto names_it = lower_bound(dataByNames.begin(), dataByNames.end(), newCitizen, nameCmp);
-        if(names_it != dataByNames.end() && (*names_it)->name == name && (*names_it)->address == addr) return false;
+void testStringPool ()
+{
+    CStringPool pool;
+    uint32_t account = pool . add ( "Account 1" ), street = pool . intern ( "Street" );
+    assert ( pool . intern ( "Street" ) == street && pool . get ( account ) == "Account 1" );
+    pool . release ( account );
+    assert ( pool . add ( "Account 2" ) == account && pool . get ( account ) == "Account 2" );
 
-        auto account_it = lower_bound(dataByAccounts.begin(), dataByAccounts.end(), newCitizen, accountCmp);
-        if(account_it != dataByAccounts.end() && (*account_it)->account == account) return false;
+    //The interned string lives until its last holder lets go, then its id serves another string
+    pool . release ( street );
+    assert ( pool . get ( street ) == "Street" );
+    pool . release ( street );
+    uint32_t other = pool . intern ( "Avenue" );
+    assert ( other == street && pool . get ( other ) == "Avenue" && pool . intern ( "Avenue" ) == other );
 
-        dataByNames.emplace(names_it, newCitizen);
-        dataByAccounts.emplace(account_it,newCitizen);
-        return true;
+    //Churn reuses the same slots instead of growing the pool
+    char buffer[32];
+    size_t before = allocationCount;
+    for(int i = 0; i < 100000; i++){
+        snprintf ( buffer, sizeof(buffer), "Account %d", i );
+        uint32_t id = pool . add ( buffer );
+        assert ( pool . get ( id ) == buffer );
+        pool . release ( id );
     }
+    assert ( allocationCount == before );
+}
+
+void testConcurrent ()
+{
+    CConcurrentTaxRegister reg(4);
+    for(int i = 0; i < 100; i++) assert ( reg . birth ( "Name " + to_string(i), "Addr", "Acc " + to_string(i) ) );
+    assert ( !reg . birth ( "Name 5", "Addr", "Acc X" ) );
+    assert ( !reg . birth ( "Name X", "Addr", "Acc 5" ) );
 
+    vector<thread> threads;
+    for(int t = 0; t < 4; t++){
+        threads . emplace_back ( [&reg, t]{
+            for(int i = 0; i < 2000; i++){
+                assert ( reg . income ( "Acc " + to_string(i % 100), 1 ) );
+                assert ( reg . expense ( "Name " + to_string(i % 100), "Addr", 2 ) );
+            }
+            //Births and deaths of private names run alongside the updates
+            for(int i = 0; i < 50; i++){
+                string id = to_string(t) + "/" + to_string(i);
+                assert ( reg . birth ( "Temp " + id, "Addr", "Temp " + id ) );
+                assert ( reg . death ( "Temp " + id, "Addr" ) );
+            }
+        } );
+    }
+    size_t listed = 0;
+    for(int round = 0; round < 5; round++){
+        listed = 0;
+        for(CShardedIterator it = reg . listByName (); ! it . atEnd (); it . next ()) listed++;
+        assert ( listed >= 100 );
+    }
+    for(thread & th : threads) th . join ();
 
-    bool death (const std::string & name, const std::string & addr){
-        auto deadCitizen = make_shared<Citizen>(name,addr, "");
+    string acct;
+    int sumIncome, sumExpense;
+    for(int i = 0; i < 100; i++){
+        assert ( reg . audit ( "Name " + to_string(i), "Addr", acct, sumIncome, sumExpense ) );
+        assert ( acct == "Acc " + to_string(i) && sumIncome == 80 && sumExpense == 160 );
+    }
+    assert ( reg . death ( "Name 5", "Addr" ) );
+    assert ( !reg . income ( "Acc 5", 1 ) );
+    string previous;
+    listed = 0;
+    for(CShardedIterator it = reg . listByName (); ! it . atEnd (); it . next ()){
+        assert ( previous < it . name () );
+        previous = it . name ();
+        listed++;
+    }
+    assert ( listed == 99 );
 
-        auto names_it = lower_bound(dataByNames.begin(), dataByNames.end(), deadCitizen, nameCmp);
-        if(names_it == dataByNames.end() || (*names_it)->name != name || (*names_it)->address != addr) return false;
+    //Deaths racing rebirths under other accounts find the account changed and start over
+    CConcurrentTaxRegister shared(4);
+    atomic<int> alive = 0;
+    threads . clear ();
+    for(int t = 0; t < 4; t++){
+        threads . emplace_back ( [&shared, &alive, t]{
+            for(int i = 0; i < 500; i++){
+                if(shared . birth ( "Shared", "Addr", "Acc " + to_string(t) + "/" + to_string(i) )) alive++;
+                if(shared . death ( "Shared", "Addr" )) alive--;
+            }
+        } );
+    }
+    for(thread & th : threads) th . join ();
+    assert ( alive == (shared . audit ( "Shared", "Addr", acct, sumIncome, sumExpense ) ? 1 : 0) );
+}
 
-        auto account_it = lower_bound(dataByAccounts.begin(), dataByAccounts.end(), (*names_it), accountCmp);
-        if(account_it == dataByAccounts.end() || (*account_it)->account != (*names_it)->account) return false;
+void testSnapshots ()
+{
+    CTaxRegister reg;
+    for(int i = 0; i < 1000; i++) assert ( reg . birth ( "Name " + to_string(1000 + i), "Addr", "Acc " + to_string(i) ) );
 
-        dataByNames.erase(names_it);
-        dataByAccounts.erase(account_it);
-        return true;
+    CIterator it = reg . listByName ();
+    int expected = 1000;
+    for(int step = 0; step < 1000; step++){
+        assert ( ! it . atEnd () && it . name () == "Name " + to_string(expected) );
+        //Kill the citizen just ahead, re-create it with another account and add strangers around
+        string ahead = "Name " + to_string(1000 + (step + 7) % 1000);
+        assert ( reg . death ( ahead, "Addr" ) );
+        assert ( reg . birth ( ahead, "Addr", "New " + to_string(step) ) );
+        assert ( reg . birth ( "Name " + to_string(1000 + step) + "b", "Addr", "Extra " + to_string(step) ) );
+        it . next ();
+        expected++;
     }
+    assert ( it . atEnd () );
 
-    bool income (const std::string & account, int amount){
-        auto citizen = make_shared<Citizen>("","",account);
+    string acct;
+    int sumIncome, sumExpense;
+    assert ( reg . income ( "New 3", 10 ) );
+    assert ( !reg . income ( "Acc 10", 10 ) );
+    assert ( reg . audit ( "Name 1010", "Addr", acct, sumIncome, sumExpense ) );
+    assert ( acct == "New 3" && sumIncome == 10 );
 
-        auto it = lower_bound(dataByAccounts.begin(),dataByAccounts.end(), citizen, accountCmp);
-        if(it == dataByAccounts.end() || (*it)->account != account) return false;
+    CIterator later = reg . listByName ();
+    size_t listed = 0;
+    for(; ! later . atEnd (); later . next ()) listed++;
+    assert ( listed == 2000 );
 
-        (*it)->income += amount;
-        return true;
+    //Old versions are dropped once no snapshot needs them, the register keeps working normally
+    assert ( reg . death ( "Name 1010", "Addr" ) );
+    assert ( !reg . audit ( "Name 1010", "Addr", acct, sumIncome, sumExpense ) );
+    assert ( reg . birth ( "Name 1010", "Addr", "Acc 10" ) );
+    assert ( reg . audit ( "Name 1010", "Addr", acct, sumIncome, sumExpense ) );
+    assert ( acct == "Acc 10" && sumIncome == 0 );
+}
+
+void testNoAllocations ()
+{
+    CTaxRegister reg;
+    for(int i = 0; i < 1000; i++){
+        reg . birth ( "A rather long citizen name " + to_string(i), "A rather long street name " + to_string(i % 10), "ACC" + to_string(i) );
     }
-    bool income (const std::string & name, const std::string & addr, int amount){
-        auto citizen = make_shared<Citizen>(name, addr, "");
+    const string name = "A rather long citizen name 500", addr = "A rather long street name 0", account = "ACC500";
+    const string missing = "Nobody", missingAccount = "ACC-1";
+    string acct;
+    int sumIncome, sumExpense;
+    acct . reserve ( 32 );
 
-        auto it = lower_bound(dataByNames.begin(),dataByNames.end(), citizen, nameCmp);
-        if(it == dataByNames.end() || (*it)->name != name || (*it)->address != addr) return false;
+    size_t before = allocationCount;
+    for(int i = 0; i < 100; i++){
+        assert ( reg . income ( account, 10 ) );
+        assert ( reg . expense ( account, 5 ) );
+        assert ( reg . income ( name, addr, 10 ) );
+        assert ( reg . expense ( name, addr, 5 ) );
+        assert ( reg . audit ( name, addr, acct, sumIncome, sumExpense ) );
+        assert ( !reg . income ( missingAccount, 10 ) );
+        assert ( !reg . audit ( missing, addr, acct, sumIncome, sumExpense ) );
+        assert ( !reg . death ( missing, addr ) );
+    }
+    assert ( reg . death ( name, addr ) );
+    assert ( allocationCount == before );
+    assert ( acct == account && sumIncome == 2000 && sumExpense == 1000 );
+}
 
-        (*it)->income += amount;
-        return true;
+void testImage ()
+{
+    const string path = "test_register.img";
+    {
+        CTaxRegister reg;
+        for(int i = 0; i < 1000; i++) assert ( reg . birth ( "Name " + to_string(1000 + i), "Street " + to_string(i % 7), "Acc " + to_string(i) ) );
+        for(int i = 0; i < 1000; i += 10) assert ( reg . death ( "Name " + to_string(1000 + i), "Street " + to_string(i % 7) ) );
+        assert ( reg . income ( "Acc 1", 100 ) );
+        assert ( reg . expense ( "Name 1002", "Street 2", 30 ) );
+        assert ( reg . save ( path ) );
     }
-    bool expense (const std::string & account, int amount){
-        auto citizen = make_shared<Citizen>("","",account);
 
-        auto it = lower_bound(dataByAccounts.begin(),dataByAccounts.end(), citizen, accountCmp);
-        if(it == dataByAccounts.end() || (*it)->account != account) return false;
+    CTaxRegister reg = CTaxRegister::open ( path );
+    string acct;
+    int sumIncome, sumExpense;
+    assert ( reg . audit ( "Name 1001", "Street 1", acct, sumIncome, sumExpense ) );
+    assert ( acct == "Acc 1" && sumIncome == 100 && sumExpense == 0 );
+    assert ( reg . audit ( "Name 1002", "Street 2", acct, sumIncome, sumExpense ) );
+    assert ( acct == "Acc 2" && sumIncome == 0 && sumExpense == 30 );
+    assert ( !reg . audit ( "Name 1010", "Street 3", acct, sumIncome, sumExpense ) );
+    assert ( !reg . birth ( "Name 1001", "Street 1", "Acc X" ) );
+    assert ( !reg . birth ( "Name X", "Street 1", "Acc 1" ) );
+    assert ( reg . birth ( "Name 1010", "Street 3", "Acc 10" ) );
+    assert ( reg . income ( "Acc 3", 5 ) );
+    assert ( reg . expense ( "Acc 10", 7 ) );
 
-        (*it)->expenses += amount;
-        return true;
+    //Deaths of image citizens stay invisible to an older listing
+    CIterator it = reg . listByName ();
+    assert ( reg . death ( "Name 1001", "Street 1" ) );
+    assert ( !reg . income ( "Acc 1", 5 ) );
+    assert ( reg . birth ( "Name 1001", "Street 1", "Acc 1" ) );
+    assert ( !reg . bulkBirth ( vector<tuple<string, string, string>>{ { "Name 1003", "Street 3", "Acc Y" } } ) );
+    assert ( !reg . bulkBirth ( vector<tuple<string, string, string>>{ { "Name Y", "Street 3", "Acc 3" } } ) );
+    vector<bool> applied = reg . applyBatch ( vector<Transaction> {
+        { "Acc 4", 10, Transaction::EKind::Income },
+        { "Acc 10", 1, Transaction::EKind::Expense },
+        { "Acc 20", 1, Transaction::EKind::Expense } } );
+    assert ( applied == ( vector<bool> { true, true, false } ) );
+
+    string previous;
+    size_t listed = 0;
+    for(; ! it . atEnd (); it . next ()){
+        assert ( previous < it . name () );
+        previous = it . name ();
+        listed++;
     }
-    bool expense (const std::string & name, const std::string& addr, int amount){
-        auto citizen = make_shared<Citizen>(name, addr, "");
+    assert ( listed == 901 );
 
-        auto it = lower_bound(dataByNames.begin(),dataByNames.end(), citizen, nameCmp);
-        if(it == dataByNames.end() || (*it)->name != name || (*it)->address != addr) return false;
+    //Saving over the file the register is mapped from keeps the register working
+    assert ( reg . save ( path ) );
+    assert ( reg . audit ( "Name 1003", "Street 3", acct, sumIncome, sumExpense ) );
+    assert ( acct == "Acc 3" && sumIncome == 5 );
+    CTaxRegister reopened = CTaxRegister::open ( path );
+    assert ( reopened . audit ( "Name 1001", "Street 1", acct, sumIncome, sumExpense ) );
+    assert ( acct == "Acc 1" && sumIncome == 0 );
+    assert ( reopened . audit ( "Name 1010", "Street 3", acct, sumIncome, sumExpense ) );
+    assert ( acct == "Acc 10" && sumExpense == 8 );
+    assert ( reopened . audit ( "Name 1004", "Street 4", acct, sumIncome, sumExpense ) );
+    assert ( sumIncome == 10 );
+    listed = 0;
+    for(CIterator it2 = reopened . listByName (); ! it2 . atEnd (); it2 . next ()) listed++;
+    assert ( listed == 901 );
+    remove ( path . c_str () );
 
-        (*it)->expenses += amount;
+    auto opens = [&path]{
+        try {
+            CTaxRegister::open ( path );
+        } catch (const runtime_error &) {
+            return false;
+        }
         return true;
+    };
+    assert ( !opens () );
+
+    //Damaged images are refused on open rather than read out of bounds later: a string offset past
+    //the heap, a string running past its end, a row number in the account order, a truncated file
+    const size_t rowsAt = 48, rowSize = 40, people = 3;
+    auto damaged = [&](size_t at, uint64_t value, size_t bytes){
+        CTaxRegister small;
+        for(size_t i = 0; i < people; i++) assert ( small . birth ( "Name " + to_string(i), "Street", "Acc " + to_string(i) ) );
+        assert ( small . save ( path ) );
+        FILE * file = fopen ( path . c_str (), "r+b" );
+        fseek ( file, at, SEEK_SET );
+        fwrite ( &value, bytes, 1, file );
+        fclose ( file );
+        return opens ();
+    };
+    assert ( damaged ( 0, 0, 0 ) );
+    assert ( !damaged ( rowsAt + rowSize + 16, 1ull << 40, 8 ) );
+    assert ( !damaged ( rowsAt + people * rowSize + people * 4, 1000, 4 ) );
+    assert ( !damaged ( rowsAt + people * rowSize + 4, people, 4 ) );
+    assert ( damaged ( 0, 0, 0 ) && truncate ( path . c_str (), rowsAt + people * rowSize + people * 4 + 2 ) == 0 && !opens () );
+    remove ( path . c_str () );
+}
+
+void testLog ()
+{
+    const string path = "test_tax.log";
+    remove ( path . c_str () );
+    {
+        CConcurrentTaxRegister reg ( 4, path );
+        vector<thread> threads;
+        for(int t = 0; t < 4; t++){
+            threads . emplace_back ( [&reg, t]{
+                for(int i = 0; i < 100; i++){
+                    string id = to_string(t) + "/" + to_string(i);
+                    assert ( reg . birth ( "Name " + id, "Addr", "Acc " + id ) );
+                    assert ( reg . income ( "Acc " + id, 10 ) );
+                    assert ( reg . expense ( "Name " + id, "Addr", 3 ) );
+                    if(i % 4 == 0) assert ( reg . death ( "Name " + id, "Addr" ) );
+                }
+            } );
+        }
+        for(thread & th : threads) th . join ();
+        assert ( !reg . income ( "Acc 0/0", 1 ) );
     }
-    bool audit (const std::string & name, const std::string & addr,
-                std::string & account, int & sumIncome, int & sumExpense) const {
-        auto citizen = make_shared<Citizen>(name,addr,"");
 
-        auto it = lower_bound(dataByNames.begin(), dataByNames.end(), citizen, nameCmp);
-        if(it == dataByNames.end() || (*it)->name != name ||(*it)->address != addr) return false;
+    //A torn record at the end is dropped on replay
+    FILE * file = fopen ( path . c_str (), "ab" );
+    fwrite ( "\x01\x02\x03\x04\x05\x06\x07", 1, 7, file );
+    fclose ( file );
+    {
+        CConcurrentTaxRegister reg ( 2, path );
+        string acct;
+        int sumIncome, sumExpense;
+        assert ( !reg . audit ( "Name 0/0", "Addr", acct, sumIncome, sumExpense ) );
+        assert ( reg . audit ( "Name 3/99", "Addr", acct, sumIncome, sumExpense ) );
+        assert ( acct == "Acc 3/99" && sumIncome == 10 && sumExpense == 3 );
+        size_t listed = 0;
+        for(CShardedIterator it = reg . listByName (); ! it . atEnd (); it . next ()) listed++;
+        assert ( listed == 300 );
+        assert ( reg . birth ( "Name 0/0", "Addr", "Acc new" ) );
+        assert ( reg . income ( "Name 3/99", "Addr", 5 ) );
+    }
 
-        account = (*it)->account;
-        sumIncome = (*it)->income;
-        sumExpense = (*it)->expenses;
-        return true;
+    //Appends without a replay go after the last complete record too, past a torn one
+    file = fopen ( path . c_str (), "ab" );
+    fwrite ( "\x01\x02\x03", 1, 3, file );
+    fclose ( file );
+    {
+        CTaxLog log ( path );
+        log . sync ( log . append ( { CTaxLog::EKind::IncomeByName, "Name 3/99", "Addr", {}, 7 } ) );
     }
-    CIterator listByName () const{
-        return CIterator(dataByNames);
+    {
+        CConcurrentTaxRegister reg ( 8, path );
+        string acct;
+        int sumIncome, sumExpense;
+        assert ( reg . audit ( "Name 0/0", "Addr", acct, sumIncome, sumExpense ) );
+        assert ( acct == "Acc new" && sumIncome == 0 );
+        assert ( reg . audit ( "Name 3/99", "Addr", acct, sumIncome, sumExpense ) );
+        assert ( sumIncome == 22 );
     }
-private:
-    vector<shared_ptr<Citizen>> dataByNames;
-    vector<shared_ptr<Citizen>> dataByAccounts;
-};
+    remove ( path . c_str () );
+}
 
-#ifndef __PROGTEST__
-int main ()
+void testRanges ()
+{
+    const string path = "test_ranges.img";
+    auto fill = [](CTaxRegister & reg, int from, int to){
+        for(int i = from; i < to; i++){
+            string id = to_string(i);
+            assert ( reg . birth ( ( i % 3 ? "Smith " : "Novak " ) + id, "Addr " + to_string(i % 5), "Acc " + to_string(i * 7 % 1000) ) );
+        }
+    };
+    {
+        CTaxRegister reg;
+        fill ( reg, 100, 600 );
+        assert ( reg . save ( path ) );
+    }
+    CTaxRegister reg = CTaxRegister::open ( path );
+    fill ( reg, 600, 1000 );
+    for(int i = 100; i < 1000; i += 9) assert ( reg . death ( ( i % 3 ? "Smith " : "Novak " ) + to_string(i), "Addr " + to_string(i % 5) ) );
+
+    //Every range listing must match filtering the full listing
+    auto check = [&reg](auto it, auto inRange, auto keyOf){
+        size_t matched = 0;
+        for(CIterator all = reg . listByName (); ! all . atEnd (); all . next ()) matched += inRange ( all );
+        string previous;
+        size_t listed = 0;
+        for(; ! it . atEnd (); it . next ()){
+            assert ( inRange ( it ) && previous < keyOf ( it ) );
+            previous = keyOf ( it );
+            listed++;
+        }
+        assert ( listed == matched );
+        return listed;
+    };
+    auto name = [](const auto & it){ return it . name () + "/" + it . addr (); };
+    auto account = [](const auto & it){ return it . account (); };
+    assert ( check ( reg . listByNamePrefix ( "Smith 2" ), [](const auto & it){ return it . name () . starts_with ( "Smith 2" ); }, name ) > 0 );
+    assert ( check ( reg . listByNamePrefix ( "Novak" ), [](const auto & it){ return it . name () . starts_with ( "Novak" ); }, name ) > 0 );
+    assert ( check ( reg . listByNamePrefix ( "Nobody" ), [](const auto &){ return false; }, name ) == 0 );
+    assert ( check ( reg . listByName ( "Novak 5", "Smith 3" ), [](const auto & it){ return it . name () >= "Novak 5" && it . name () <= "Smith 3"; }, name ) > 0 );
+    assert ( check ( reg . listByName ( "Smith 700", "Smith 700" ), [](const auto & it){ return it . name () == "Smith 700"; }, name ) == 1 );
+    assert ( check ( reg . listByAccount ( "Acc 2", "Acc 4" ), [](const auto & it){ return it . account () >= "Acc 2" && it . account () <= "Acc 4"; }, account ) > 0 );
+    assert ( check ( reg . listByAccount ( "", "Acc 15" ), [](const auto & it){ return it . account () <= "Acc 15"; }, account ) > 0 );
+
+    //A range listing is a snapshot like the full one, in both layers
+    CAccountIterator changed = reg . listByAccount ( "Acc 207", "Acc 207" );
+    CAccountIterator imaged = reg . listByAccount ( "Acc 707", "Acc 707" );
+    assert ( reg . death ( "Smith 601", "Addr 1" ) );
+    assert ( reg . death ( "Smith 101", "Addr 1" ) );
+    assert ( reg . birth ( "Smith X", "Addr", "Acc 207" ) );
+    assert ( ! changed . atEnd () && changed . name () == "Smith 601" );
+    changed . next ();
+    assert ( changed . atEnd () );
+    assert ( ! imaged . atEnd () && imaged . name () == "Smith 101" );
+    assert ( reg . listByNamePrefix ( "Smith 601" ) . atEnd () );
+    assert ( reg . listByAccount ( "Acc 707", "Acc 707" ) . atEnd () );
+    CAccountIterator later = reg . listByAccount ( "Acc 207", "Acc 207" );
+    assert ( ! later . atEnd () && later . name () == "Smith X" );
+    remove ( path . c_str () );
+}
+
+void testReports ()
+{
+    const string path = "test_reports.img";
+    {
+        CTaxRegister reg;
+        for(int i = 0; i < 300; i++) assert ( reg . birth ( "Name " + to_string(i), "Addr", "Acc " + to_string(i) ) );
+        for(int i = 0; i < 300; i++) assert ( reg . income ( "Acc " + to_string(i), i * 37 % 1000 ) );
+        assert ( reg . save ( path ) );
+    }
+    CTaxRegister reg = CTaxRegister::open ( path );
+    string acct, name, addr;
+    int sumIncome, sumExpense;
+
+    //Everything the reports say must follow from listing and auditing the register
+    auto check = [&](){
+        vector<tuple<string, int, int>> all;
+        for(CIterator it = reg . listByName (); ! it . atEnd (); it . next ()){
+            assert ( reg . audit ( it . name (), it . addr (), acct, sumIncome, sumExpense ) );
+            all . emplace_back ( it . name (), sumIncome, sumExpense );
+        }
+        CTaxSummary total = reg . summarize ();
+        assert ( total . count == all . size () );
+        for(auto [from, to] : { pair<string, string>{ "Name 1", "Name 2" }, { "Name 150", "Name 150" }, { "A", "Z" }, { "X", "Y" } }){
+            CTaxSummary expected;
+            for(const auto & [n, income, expenses] : all){
+                if(n >= from && n <= to) expected += { 1, income, expenses, income };
+            }
+            CTaxSummary actual = reg . summarize ( from, to );
+            assert ( actual . count == expected . count && actual . income == expected . income && actual . expenses == expected . expenses );
+            assert ( actual . count == 0 || actual . maxIncome == expected . maxIncome );
+        }
+        for(size_t k = 0; k < all . size (); k += 17){
+            assert ( reg . nth ( k, name, addr ) && name == get<0> ( all[k] ) );
+            assert ( reg . rank ( name, addr ) == k );
+        }
+        assert ( !reg . nth ( all . size (), name, addr ) );
+        vector<tuple<string, string, int>> top = reg . topEarners ( 10 );
+        vector<int> incomes;
+        for(const auto & citizen : all) incomes . push_back ( get<1> ( citizen ) );
+        sort ( incomes . rbegin (), incomes . rend () );
+        assert ( top . size () == min<size_t> ( 10, all . size () ) );
+        for(size_t i = 0; i < top . size (); i++) assert ( get<2> ( top[i] ) == incomes[i] );
+    };
+
+    check ();
+    mt19937 rng(5);
+    for(int round = 0; round < 20; round++){
+        for(int op = 0; op < 100; op++){
+            int id = rng() % 400;
+            string n = "Name " + to_string(id), a = "Acc " + to_string(id);
+            switch(rng() % 5){
+                case 0: reg . birth ( n, "Addr", a ); break;
+                case 1: reg . death ( n, "Addr" ); break;
+                case 2: reg . income ( a, int(rng() % 2000) - 500 ); break;
+                case 3: reg . expense ( n, "Addr", int(rng() % 100) ); break;
+                default: reg . applyBatch ( vector<Transaction> { { a, int(rng() % 3000), Transaction::EKind::Income } } );
+            }
+        }
+        check ();
+    }
+    remove ( path . c_str () );
+}
+
+void testCompaction ()
+{
+    CTaxRegister reg;
+    for(int i = 0; i < 20000; i++) assert ( reg . birth ( "Name " + to_string(i), "Addr", "Acc " + to_string(i) ) );
+
+    //A listing keeps the tombstones it can see through any number of compactions
+    size_t listed = 0;
+    {
+        CIterator before = reg . listByName ();
+        for(int i = 0; i < 20000; i += 2) assert ( reg . death ( "Name " + to_string(i), "Addr" ) );
+        reg . compact ();
+        assert ( reg . tombstones () == 10000 );
+        for(int i = 0; i < 20000; i += 4) assert ( reg . birth ( "Name " + to_string(i), "Addr", "New " + to_string(i) ) );
+        for(; ! before . atEnd (); before . next ()) listed++;
+        assert ( listed == 20000 );
+    }
+
+    //Once the listing is gone, the threshold drops every tombstone with the next deaths
+    for(int i = 1; i < 20000; i += 4) assert ( reg . death ( "Name " + to_string(i), "Addr" ) );
+    assert ( reg . tombstones () < 5000 );
+    reg . compact ();
+    assert ( reg . tombstones () == 0 );
+
+    string acct;
+    int sumIncome, sumExpense;
+    assert ( !reg . audit ( "Name 2", "Addr", acct, sumIncome, sumExpense ) );
+    assert ( !reg . income ( "Acc 2", 1 ) );
+    assert ( reg . audit ( "Name 4", "Addr", acct, sumIncome, sumExpense ) && acct == "New 4" );
+    assert ( reg . audit ( "Name 3", "Addr", acct, sumIncome, sumExpense ) && acct == "Acc 3" );
+    assert ( reg . birth ( "Name 1", "Addr", "Acc 1" ) );
+    listed = 0;
+    for(CIterator it = reg . listByName (); ! it . atEnd (); it . next ()) listed++;
+    assert ( listed == 5000 + 5000 + 1 );
+    listed = 0;
+    for(CAccountIterator it = reg . listByAccount ( "Acc", "Acc 9" ); ! it . atEnd (); it . next ()) listed++;
+    assert ( listed > 0 );
+
+    //Without automatic compaction the tombstones stay until asked
+    reg . setCompactionRatio ( 1e9 );
+    for(int i = 3; i < 20000; i += 4) assert ( reg . death ( "Name " + to_string(i), "Addr" ) );
+    assert ( reg . tombstones () == 5000 );
+    reg . compact ();
+    assert ( reg . tombstones () == 0 );
+}
+
+void testTaxes ()
+{
+    const vector<CTaxBracket> brackets { { 0, 0 }, { 10000, 1500 }, { 50000, 2300 }, { 1000000, 4500 } };
+    CTaxEngine engine ( brackets );
+    assert ( engine . tax ( 10000, 0 ) == 0 );
+    assert ( engine . tax ( 20000, 0 ) == 1500 );
+    assert ( engine . tax ( 70000, 10000 ) == 6000 + 2300 );
+    assert ( engine . tax ( 100, 5000 ) == 0 );
+    assert ( engine . tax ( INT_MAX, INT_MIN ) == ( 40000LL * 1500 + 950000LL * 2300 + ( 4294967295LL - 1000000 ) * 4500 ) / 10000 );
+
+    //The vector kernel, the threads and the tails agree with the scalar one, extremes included
+    mt19937 rng ( 14 );
+    for(size_t size : { 0, 3, 17, 200000 }){
+        vector<int> incomes ( size ), expenses ( size );
+        for(size_t i = 0; i < size; i++){
+            incomes[i] = i % 7 == 0 ? INT_MAX : int(rng() % 3000000) - 1000;
+            expenses[i] = i % 11 == 0 ? INT_MIN : int(rng() % 100000);
+        }
+        for(size_t threads : { 1, 4 }){
+            vector<long long> taxes ( size, -1 );
+            engine . compute ( incomes, expenses, taxes, threads );
+            for(size_t i = 0; i < size; i++) assert ( taxes[i] == engine . tax ( incomes[i], expenses[i] ) );
+        }
+    }
+
+    bool thrown = false;
+    try { CTaxEngine ( vector<CTaxBracket> { { 0, 1000 }, { 0, 2000 } } ); } catch ( const invalid_argument & ) { thrown = true; }
+    assert ( thrown );
+
+    CTaxRegister reg;
+    assert ( reg . birth ( "Bob", "Addr", "B" ) && reg . birth ( "Alice", "Addr", "A" ) && reg . birth ( "Carol", "Addr", "C" ) );
+    assert ( reg . income ( "A", 30000 ) && reg . income ( "B", 80000 ) && reg . expense ( "B", 20000 ) );
+    vector<long long> taxes ( 2 );
+    assert ( !reg . computeTaxes ( brackets, taxes ) );
+    taxes . resize ( 3 );
+    assert ( reg . computeTaxes ( brackets, taxes ) );
+    assert ( taxes == ( vector<long long> { 3000, 6000 + 2300, 0 } ) );
+}
+
+void testCsv ()
+{
+    const string path = "testCsv.csv";
+    string acct;
+    int sumIncome, sumExpense;
+    CTaxRegister reg;
+    for(int i = 0; i < 50000; i++){
+        assert ( reg . birth ( "Name " + to_string(i), "Addr", "Acc " + to_string(i) ) );
+        assert ( reg . income ( "Acc " + to_string(i), i - 100 ) );
+    }
+    assert ( reg . birth ( "Smith, John", "\"Old\" Mill", "A,\"B\"" ) );
+    assert ( reg . expense ( "A,\"B\"", 700 ) );
+    assert ( reg . death ( "Name 7", "Addr" ) );
+
+    //Threads, chunks and quoting round-trip exactly
+    for(size_t threads : { 1, 3 }){
+        assert ( reg . exportCsv ( path, threads ) );
+        CTaxRegister copy;
+        assert ( copy . importCsv ( path, threads ) );
+        CIterator a = reg . listByName (), b = copy . listByName ();
+        for(; ! a . atEnd (); a . next (), b . next ()){
+            assert ( ! b . atEnd () && a . name () == b . name () && a . addr () == b . addr () && a . account () == b . account () );
+            assert ( copy . audit ( a . name (), a . addr (), acct, sumIncome, sumExpense ) );
+            int income, expenses;
+            reg . audit ( a . name (), a . addr (), acct, income, expenses );
+            assert ( income == sumIncome && expenses == sumExpense );
+        }
+        assert ( b . atEnd () );
+        assert ( ! copy . importCsv ( path ) );
+    }
+    assert ( reg . birth ( "Two\nLines", "Addr", "Broken" ) );
+    assert ( ! reg . exportCsv ( path ) );
+
+    //A malformed line rejects the whole file
+    FILE * file = fopen ( path . c_str (), "w" );
+    fputs ( "A,Addr,X1,5,0\r\n\"B,Addr,X2,1,1\r\n", file );
+    fclose ( file );
+    CTaxRegister bad;
+    assert ( ! bad . importCsv ( path ) );
+    assert ( ! bad . audit ( "A", "Addr", acct, sumIncome, sumExpense ) );
+    file = fopen ( path . c_str (), "w" );
+    fputs ( "A,Addr,X1,5,0\r\n\"B\",Addr,X2,1,-1\r\n\n", file );
+    fclose ( file );
+    assert ( bad . importCsv ( path ) );
+    assert ( bad . audit ( "B", "Addr", acct, sumIncome, sumExpense ) && acct == "X2" && sumIncome == 1 && sumExpense == -1 );
+    assert ( ! bad . importCsv ( "missing.csv" ) );
+    remove ( path . c_str () );
+}
+
+int main (int argc, char * argv[])
 {
+#ifdef BENCHMARK_SUITE
+    benchmarkSuite(argc > 1 ? stoull(argv[1]) : 1'000'000);
+    return EXIT_SUCCESS;
+#endif
+    if(argc > 1 && strcmp(argv[1], "bench") == 0){
+        benchmarkBirthDeath();
+        benchmarkBulkLoad();
+        benchmarkBatch();
+        benchmarkConcurrent();
+        benchmarkMemory();
+        benchmarkImage();
+        benchmarkLog();
+        benchmarkRanges();
+        benchmarkReports();
+        benchmarkMassDeath();
+        benchmarkTaxes();
+        benchmarkCsv();
+        return EXIT_SUCCESS;
+    }
+
     int a[] = {1,2,3,4,5};
 
 
@@ -239,6 +4041,87 @@ int main ()
     assert ( sumExpense == 0 );
     assert ( !b1 . birth ( "Joe Hacker", "Elm Street 23", "AAj5#94" ) );
 
+    testTree();
+    testHashIndex();
+    testStringPool();
+    testSnapshots();
+    testNoAllocations();
+    testConcurrent();
+    testImage();
+    testLog();
+    testRanges();
+    testReports();
+    testCompaction();
+    testTaxes();
+    testCsv();
+
+    CTaxRegister b2;
+    for(int i = 0; i < 5000; i++){
+        assert ( b2 . birth ( "Name " + to_string(i), "Addr", "Acc " + to_string(i) ) );
+    }
+    for(int i = 0; i < 5000; i += 2){
+        assert ( b2 . death ( "Name " + to_string(i), "Addr" ) );
+    }
+    size_t listed = 0;
+    for(CIterator it2 = b2 . listByName (); ! it2 . atEnd (); it2 . next ()) listed++;
+    assert ( listed == 2500 );
+    assert ( !b2 . income ( "Acc 4", 10 ) );
+    assert ( b2 . income ( "Acc 5", 10 ) );
+
+    CTaxRegister b3;
+    assert ( b3 . birth ( "John Smith", "Oak Road 23", "123/456/789" ) );
+    assert ( !b3 . bulkBirth ( vector<tuple<string, string, string>>{
+            { "Jane Hacker", "Main Street 17", "Xuj5#94" },
+            { "John Smith", "Oak Road 23", "634oddT" } } ) );
+    assert ( !b3 . bulkBirth ( vector<tuple<string, string, string>>{
+            { "Jane Hacker", "Main Street 17", "Xuj5#94" },
+            { "Peter Hacker", "Main Street 17", "Xuj5#94" } } ) );
+    assert ( !b3 . bulkBirth ( vector<tuple<string, string, string>>{
+            { "Jane Hacker", "Main Street 17", "Xuj5#94" },
+            { "Jane Hacker", "Main Street 17", "634oddT" } } ) );
+    assert ( !b3 . income ( "Xuj5#94", 100 ) );
+    vector<tuple<string, string, string>> batch;
+    for(int i = 0; i < 3000; i++) batch . emplace_back ( "Name " + to_string(i), "Addr", "Acc " + to_string(i) );
+    assert ( b3 . bulkBirth ( batch ) );
+    assert ( !b3 . birth ( "Name 7", "Addr", "Acc X" ) );
+    assert ( b3 . income ( "Acc 2999", 100 ) );
+    assert ( b3 . death ( "Name 1500", "Addr" ) );
+    assert ( b3 . birth ( "Name 1500", "Addr", "Acc 1500" ) );
+    for(int i = 0; i < 3000; i += 3) assert ( b3 . death ( "Name " + to_string(i), "Addr" ) );
+    CIterator it3 = b3 . listByName ();
+    assert ( it3 . name () == "John Smith" );
+    listed = 0;
+    for(it3 . next (); ! it3 . atEnd (); it3 . next ()) {
+        assert ( it3 . addr () == "Addr" );
+        listed++;
+    }
+    assert ( listed == 2000 );
+
+    vector<Transaction> transactions {
+        { "Acc 1", 100, Transaction::EKind::Income },
+        { "Acc 3", 50, Transaction::EKind::Income },
+        { "Acc 1", 30, Transaction::EKind::Expense },
+        { "Acc X", 10, Transaction::EKind::Income },
+        { "Acc 1", 20, Transaction::EKind::Income },
+        { "Acc 2", 5, Transaction::EKind::Expense }
+    };
+    vector<bool> applied = b3 . applyBatch ( transactions );
+    assert ( applied == ( vector<bool> { true, false, true, false, true, true } ) );
+    assert ( b3 . audit ( "Name 1", "Addr", acct, sumIncome, sumExpense ) );
+    assert ( acct == "Acc 1" && sumIncome == 120 && sumExpense == 30 );
+    assert ( b3 . audit ( "Name 2", "Addr", acct, sumIncome, sumExpense ) );
+    assert ( sumIncome == 0 && sumExpense == 5 );
+    assert ( b3 . applyBatch ( {} ) . empty () );
+
+    //Amounts whose sum leaves int while the running balance never does behave as one call each
+    assert ( b3 . income ( "Acc 2", -1000 ) );
+    applied = b3 . applyBatch ( vector<Transaction> {
+        { "Acc 2", INT_MAX, Transaction::EKind::Income },
+        { "Acc 2", 500, Transaction::EKind::Income } } );
+    assert ( applied == ( vector<bool> { true, true } ) );
+    assert ( b3 . audit ( "Name 2", "Addr", acct, sumIncome, sumExpense ) );
+    assert ( sumIncome == INT_MAX - 500 && sumExpense == 5 );
+
 
 
     return EXIT_SUCCESS;